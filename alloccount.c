@@ -0,0 +1,39 @@
+#include "alloccount.h"
+
+#include <stddef.h>
+
+// the real allocator, what the linker left under these names
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+
+static uint64_t allocations = 0;
+
+static inline void M_count() {
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+}
+
+void* __wrap_malloc(size_t size) {
+    M_count();
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    M_count();
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    if (size > 0) M_count(); // realloc to 0 frees
+    return __real_realloc(ptr, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+    M_count();
+    return __real_aligned_alloc(alignment, size);
+}
+
+uint64_t alloc_count() {
+    return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,14 @@
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+// Counts heap allocations, to find the ones left on hot paths. Always in bench, in the game with
+// `make clean && make COUNT_ALLOCS=1`. The linker sends malloc, calloc, realloc and aligned_alloc through here
+// (--wrap), so calls from this program's own code are counted, not the ones libc or curses make internally.
+
+#include <stdint.h>
+
+/**
+ * Heap allocations made so far, from every thread. Frees aren't counted.
+ */
+uint64_t alloc_count();
+
+#endif
@@ -0,0 +1,196 @@
+#include "ansiterm.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "matrix.h" // FAIL
+
+#define MAX_CELL_BYTES 64 // cursor move, both colors and the glyph, with room to spare
+#define MAX_REWRITE_GAP 4 // unchanged cells in the current colors are rewritten rather than moved over, up to this many
+
+static struct AnsiCell* front = NULL; // what the screen shows
+static struct AnsiCell* back = NULL; // the next frame
+static int term_rows = 0, term_cols = 0;
+static bool clear_pending = false; // the screen has to be cleared before the next frame goes out
+
+static char* out = NULL; // escape sequences of the frame being presented, kept between frames
+static size_t out_len = 0, out_cap = 0;
+
+static const struct AnsiCell BLANK = {ANSITERM_DEFAULT_COLOR, ANSITERM_DEFAULT_COLOR, ' '};
+
+void ansiterm_resize(int rows, int cols) {
+    if (rows == term_rows && cols == term_cols && back != NULL) return;
+    if (rows < 0) rows = 0;
+    if (cols < 0) cols = 0;
+    size_t cells = (size_t)rows * (size_t)cols;
+    free(front);
+    free(back);
+    front = (struct AnsiCell*)malloc((cells ? cells : 1) * sizeof(struct AnsiCell));
+    back = (struct AnsiCell*)malloc((cells ? cells : 1) * sizeof(struct AnsiCell));
+    if (front == NULL || back == NULL) FAIL("Out of memory allocating the terminal buffers.\n");
+    term_rows = rows;
+    term_cols = cols;
+    // a cleared screen is all blanks, only what's drawn on top has to go out
+    for (size_t i = 0; i < cells; i++) front[i] = back[i] = BLANK;
+    clear_pending = true;
+}
+
+void ansiterm_put(int y, int x, const char* text, int len, uint32_t fg, uint32_t bg) {
+    if (y < 0 || y >= term_rows) return;
+    if (x < 0) {
+        text -= x;
+        len += x;
+        x = 0;
+    }
+    if (len > term_cols - x) len = term_cols - x;
+    struct AnsiCell* cell = &back[(size_t)y * (size_t)term_cols + (size_t)x];
+    for (int i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        cell[i].fg = fg;
+        cell[i].bg = bg;
+        cell[i].glyph = (c >= 0x20 && c < 0x7f) || c == ANSITERM_UPPER_HALF ? (char)c : ' ';
+    }
+}
+
+void ansiterm_erase() {
+    size_t cells = (size_t)term_rows * (size_t)term_cols;
+    for (size_t i = 0; i < cells; i++) back[i] = BLANK;
+}
+
+void ansiterm_invalidate() {
+    size_t cells = (size_t)term_rows * (size_t)term_cols;
+    for (size_t i = 0; i < cells; i++) front[i].glyph = 0;
+}
+
+void ansiterm_free() {
+    free(front);
+    free(back);
+    free(out);
+    front = back = NULL;
+    out = NULL;
+    out_len = out_cap = 0;
+    term_rows = term_cols = 0;
+}
+
+static void M_out_reserve(size_t more) {
+    if (out_len + more <= out_cap) return;
+    size_t cap = out_cap ? out_cap * 2 : 16384;
+    while (cap < out_len + more) cap *= 2;
+    char* grown = (char*)realloc(out, cap);
+    if (grown == NULL) FAIL("Out of memory allocating the terminal output.\n");
+    out = grown;
+    out_cap = cap;
+}
+
+static void M_out_str(const char* s) {
+    size_t len = strlen(s);
+    memcpy(out + out_len, s, len);
+    out_len += len;
+}
+
+static void M_out_uint(uint32_t value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) out[out_len++] = digits[--n];
+}
+
+static void M_out_glyph(char glyph) {
+    if (glyph == ANSITERM_UPPER_HALF) M_out_str("\xe2\x96\x80");
+    else out[out_len++] = glyph;
+}
+
+// the parameters of one color in an SGR sequence, `base` 38 for foreground and 48 for background
+static void M_out_color(int base, uint32_t color) {
+    if (color == ANSITERM_DEFAULT_COLOR) {
+        M_out_uint((uint32_t)base + 1);
+        return;
+    }
+    M_out_uint((uint32_t)base);
+    M_out_str(";2;");
+    M_out_uint((color >> 16) & 0xff);
+    out[out_len++] = ';';
+    M_out_uint((color >> 8) & 0xff);
+    out[out_len++] = ';';
+    M_out_uint(color & 0xff);
+}
+
+size_t ansiterm_present(int fd) {
+    out_len = 0;
+    M_out_reserve(MAX_CELL_BYTES);
+    if (clear_pending) {
+        M_out_str("\x1b[0m\x1b[H\x1b[2J");
+        clear_pending = false;
+    }
+
+    // where the cursor is and which colors are set aren't trusted across frames, curses may have moved it since
+    int cur_y = -1, cur_x = -1;
+    bool colors_known = false;
+    uint32_t cur_fg = 0, cur_bg = 0;
+    for (int y = 0; y < term_rows; y++) {
+        struct AnsiCell* back_row = &back[(size_t)y * (size_t)term_cols];
+        struct AnsiCell* front_row = &front[(size_t)y * (size_t)term_cols];
+        for (int x = 0; x < term_cols; x++) {
+            struct AnsiCell* want = &back_row[x];
+            struct AnsiCell* shown = &front_row[x];
+            if (want->glyph == shown->glyph && want->fg == shown->fg && want->bg == shown->bg) continue;
+            M_out_reserve(MAX_CELL_BYTES + MAX_REWRITE_GAP * 3);
+
+            if (cur_y == y && x == cur_x) {
+                // already there
+            } else if (cur_y == y && cur_x >= 0 && x > cur_x) {
+                int gap = x - cur_x;
+                bool rewrite = colors_known && gap <= MAX_REWRITE_GAP;
+                for (int i = cur_x; rewrite && i < x; i++)
+                    rewrite = back_row[i].bg == cur_bg && (back_row[i].glyph == ' ' || back_row[i].fg == cur_fg);
+                if (rewrite) {
+                    for (int i = cur_x; i < x; i++) M_out_glyph(back_row[i].glyph);
+                } else {
+                    M_out_str("\x1b[");
+                    M_out_uint((uint32_t)gap);
+                    out[out_len++] = 'C';
+                }
+            } else {
+                M_out_str("\x1b[");
+                M_out_uint((uint32_t)y + 1);
+                out[out_len++] = ';';
+                M_out_uint((uint32_t)x + 1);
+                out[out_len++] = 'H';
+            }
+
+            // a space doesn't show its foreground, most of the screen is spaces
+            bool fg_changed = !colors_known || (want->fg != cur_fg && want->glyph != ' ');
+            bool bg_changed = !colors_known || want->bg != cur_bg;
+            if (fg_changed || bg_changed) {
+                M_out_str("\x1b[");
+                if (fg_changed) M_out_color(38, want->fg);
+                if (fg_changed && bg_changed) out[out_len++] = ';';
+                if (bg_changed) M_out_color(48, want->bg);
+                out[out_len++] = 'm';
+                if (fg_changed) cur_fg = want->fg;
+                cur_bg = want->bg;
+                colors_known = true;
+            }
+
+            M_out_glyph(want->glyph);
+            *shown = *want;
+            // past the last column the cursor waits to wrap, where it is depends on the terminal
+            cur_y = y;
+            cur_x = x + 1 < term_cols ? x + 1 : -1;
+        }
+    }
+
+    size_t done = 0;
+    while (done < out_len) {
+        ssize_t n = write(fd, out + done, out_len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    return done;
+}
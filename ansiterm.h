@@ -0,0 +1,60 @@
+#ifndef ANSITERM_H
+#define ANSITERM_H
+// A terminal writer that doesn't go through curses. What is on screen and what the next frame should show are kept
+// as two cell buffers, and presenting a frame turns their difference into cursor moves and 24-bit color escape
+// sequences, written out with a single write(). Curses is still what sets up the terminal and reads the keys.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ANSITERM_DEFAULT_COLOR 0xffffffffu // the terminal's own foreground or background, otherwise 0xRRGGBB
+#define ANSITERM_UPPER_HALF '\x01' // glyph written as ▀
+
+struct AnsiCell {
+    uint32_t fg, bg;
+    char glyph; // 0 when unknown, so the cell is always rewritten
+};
+
+/**
+ * Make the buffers fit the terminal. A size change empties the next frame and repaints the whole screen.
+ * Cheap when the size is unchanged, every call that draws starts with it.
+ * @param rows Terminal rows
+ * @param cols Terminal columns
+ */
+void ansiterm_resize(int rows, int cols);
+
+/**
+ * Write characters into the next frame. Anything off screen is dropped.
+ * @param y Row
+ * @param x Column of the first character
+ * @param text Characters, control characters other than ANSITERM_UPPER_HALF show as spaces
+ * @param len Number of characters
+ * @param fg Foreground, 0xRRGGBB or ANSITERM_DEFAULT_COLOR
+ * @param bg Background, 0xRRGGBB or ANSITERM_DEFAULT_COLOR
+ */
+void ansiterm_put(int y, int x, const char* text, int len, uint32_t fg, uint32_t bg);
+
+/**
+ * Blank the whole next frame in the terminal's default colors.
+ */
+void ansiterm_erase();
+
+/**
+ * Forget what the screen shows, so the next present repaints all of it. For when something else wrote to it.
+ */
+void ansiterm_invalidate();
+
+/**
+ * Write out every cell of the next frame that differs from the screen, in one write().
+ * @param fd Where the terminal is.
+ * @returns Bytes written.
+ */
+size_t ansiterm_present(int fd);
+
+/**
+ * Free the buffers.
+ */
+void ansiterm_free();
+
+#endif
@@ -0,0 +1,468 @@
+// Headless benchmarks for the rules engine. Links only against the engine library, no terminal required.
+//
+// Every case is run on each board size, as a number of samples that each time a batch of operations.
+// Results go to stdout and, as CSV, to the output file (bench_results.csv unless -o is given).
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "alloccount.h"
+#include "matrix.h"
+#include "rng.h"
+#include "bot.h"
+#include "movegen.h"
+
+#define DEFAULT_OUTPUT "bench_results.csv"
+#define POSITION_COUNT 4096 // precomputed piece placements each case cycles through
+#define SAMPLE_TARGET_NS 2e6 // aim for samples of about this long
+#define STEADY_TICKS 100000 // ticks played by the allocation check
+#define PLACEMENT_CELLS 200000 // board cells searched by the placement check, so small boards get more rounds
+
+// board sizes as columns x rows, from the standard board up to the menu maximum
+static const minopos_t BENCH_SIZES[][2] = {
+    {10, 24}, {16, 40}, {32, 64}, {64, 128}, {128, 200}, {255, 255}
+};
+
+struct BenchPos {
+    enum TetrominoType_t piece;
+    uint8_t rot;
+    minopos_t x, y;
+};
+
+struct BenchCtx {
+    Matrix* mat;
+    Matrix* scratch; // for cases that need to restore a board
+    struct Bot* bot;
+    struct MoveGen* gen;
+    struct Rng rng;
+    struct BenchPos pos[POSITION_COUNT];
+    size_t next; // index into `pos`
+    volatile size_t sink; // keeps results alive
+};
+
+struct BenchCase {
+    const char* name;
+    void (*setup)(struct BenchCtx*);
+    void (*run)(struct BenchCtx*, size_t ops);
+};
+
+static double bench_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// scatter garbage over the lower part of the board, leaving a gap in every row so nothing clears
+static void fill_garbage(Matrix* mat, struct Rng* rng) {
+    for (minopos_t y = (minopos_t)(mat->_nrows * 3 / 5); y < mat->_nrows; y++) {
+        minopos_t gap = (minopos_t)rng_below(rng, (uint32_t)mat->_ncols);
+        for (minopos_t x = 0; x < mat->_ncols; x++) {
+            if (x == gap || rng_below(rng, 3) == 0) continue;
+            matrix_set_cell(mat, y, x, (enum TetrominoType_t)(1 + rng_below(rng, TETCOUNT)));
+        }
+    }
+}
+
+static void place(Matrix* mat, struct BenchPos* p) {
+    matrix_set_current_piece(mat, p->piece, p->rot);
+    mat->_tetX = p->x;
+    mat->_tetY = p->y;
+}
+
+// random positions, some of them out of bounds or colliding
+static void gen_any_positions(struct BenchCtx* ctx) {
+    for (size_t i = 0; i < POSITION_COUNT; i++) {
+        struct BenchPos* p = &ctx->pos[i];
+        p->piece = (enum TetrominoType_t)(1 + rng_below(&ctx->rng, TETCOUNT));
+        p->rot = (uint8_t)rng_below(&ctx->rng, 4);
+        p->x = (minopos_t)((int)rng_below(&ctx->rng, (uint32_t)ctx->mat->_ncols + 2) - 2);
+        p->y = (minopos_t)((int)rng_below(&ctx->rng, (uint32_t)ctx->mat->_nrows + 2) - 2);
+    }
+    ctx->next = 0;
+}
+
+// random positions the piece fits in, optionally restricted to the top rows
+static void gen_fitting_positions(struct BenchCtx* ctx, minopos_t max_y) {
+    size_t i = 0;
+    while (i < POSITION_COUNT) {
+        struct BenchPos* p = &ctx->pos[i];
+        p->piece = (enum TetrominoType_t)(1 + rng_below(&ctx->rng, TETCOUNT));
+        p->rot = (uint8_t)rng_below(&ctx->rng, 4);
+        p->x = (minopos_t)((int)rng_below(&ctx->rng, (uint32_t)ctx->mat->_ncols + 2) - 2);
+        p->y = (minopos_t)rng_below(&ctx->rng, (uint32_t)max_y);
+        place(ctx->mat, p);
+        if (M_matrix_test_tet(ctx->mat)) i++;
+    }
+    ctx->next = 0;
+}
+
+static inline struct BenchPos* next_pos(struct BenchCtx* ctx) {
+    struct BenchPos* p = &ctx->pos[ctx->next];
+    ctx->next = (ctx->next + 1) % POSITION_COUNT;
+    return p;
+}
+
+// cases ---
+
+static void setup_any(struct BenchCtx* ctx) {
+    fill_garbage(ctx->mat, &ctx->rng);
+    gen_any_positions(ctx);
+}
+
+static void run_test_tet(struct BenchCtx* ctx, size_t ops) {
+    size_t hits = 0;
+    for (size_t i = 0; i < ops; i++) {
+        place(ctx->mat, next_pos(ctx));
+        hits += M_matrix_test_tet(ctx->mat);
+    }
+    ctx->sink += hits;
+}
+
+static void run_test_tet_cells(struct BenchCtx* ctx, size_t ops) {
+    size_t hits = 0;
+    for (size_t i = 0; i < ops; i++) {
+        place(ctx->mat, next_pos(ctx));
+        hits += M_matrix_test_tet_cells(ctx->mat);
+    }
+    ctx->sink += hits;
+}
+
+static void setup_fitting(struct BenchCtx* ctx) {
+    fill_garbage(ctx->mat, &ctx->rng);
+    gen_fitting_positions(ctx, ctx->mat->_nrows);
+}
+
+static void run_paste_unpaste(struct BenchCtx* ctx, size_t ops) {
+    for (size_t i = 0; i < ops; i++) {
+        place(ctx->mat, next_pos(ctx));
+        ctx->sink += M_matrix_paste_tet(ctx->mat);
+        M_matrix_unpaste_tet(ctx->mat);
+    }
+}
+
+static void run_rotate(struct BenchCtx* ctx, size_t ops) {
+    // a rotation there and back from a fitting position, kicking off the garbage and walls where needed
+    for (size_t i = 0; i < ops; i++) {
+        place(ctx->mat, next_pos(ctx));
+        M_matrix_paste_tet(ctx->mat);
+        ctx->sink += matrix_rotate_piece(ctx->mat, 1);
+        ctx->sink += matrix_rotate_piece(ctx->mat, -1);
+        M_matrix_unpaste_tet(ctx->mat);
+    }
+}
+
+static void setup_spawn_area(struct BenchCtx* ctx) {
+    fill_garbage(ctx->mat, &ctx->rng);
+    gen_fitting_positions(ctx, (minopos_t)(ctx->mat->_rootY + 1));
+}
+
+static void run_hdrop_pos(struct BenchCtx* ctx, size_t ops) {
+    for (size_t i = 0; i < ops; i++) {
+        place(ctx->mat, next_pos(ctx));
+        M_matrix_paste_tet(ctx->mat);
+        M_matrix_set_hdrop_pos(ctx->mat);
+        ctx->sink += (size_t)ctx->mat->_hdropY;
+        M_matrix_unpaste_tet(ctx->mat);
+    }
+}
+
+// four full rows at the bottom, under garbage
+static void setup_clear(struct BenchCtx* ctx) {
+    Matrix* s = ctx->scratch;
+    matrix_reset(s, ctx->mat->_nrows, ctx->mat->_ncols);
+    fill_garbage(s, &ctx->rng);
+    for (minopos_t y = (minopos_t)(s->_nrows - 4); y < s->_nrows; y++) {
+        for (minopos_t x = 0; x < s->_ncols; x++) matrix_set_cell(s, y, x, I);
+    }
+}
+
+// restoring the board is part of every op, `restore_board` measures that part on its own
+static void run_restore(struct BenchCtx* ctx, size_t ops) {
+    size_t bits = (size_t)ctx->mat->_nrows * ctx->mat->_bbStride * sizeof(bbword_t);
+    size_t cells = (size_t)ctx->mat->_nrows * (size_t)ctx->mat->_ncols * sizeof(struct Mino);
+    for (size_t i = 0; i < ops; i++) {
+        memcpy(ctx->mat->_bits, ctx->scratch->_bits, bits);
+        memcpy(ctx->mat->_board, ctx->scratch->_board, cells);
+        ctx->sink += ctx->mat->_board[0].occupied;
+    }
+}
+
+static void run_clear_lines(struct BenchCtx* ctx, size_t ops) {
+    size_t bits = (size_t)ctx->mat->_nrows * ctx->mat->_bbStride * sizeof(bbword_t);
+    size_t cells = (size_t)ctx->mat->_nrows * (size_t)ctx->mat->_ncols * sizeof(struct Mino);
+    for (size_t i = 0; i < ops; i++) {
+        memcpy(ctx->mat->_bits, ctx->scratch->_bits, bits);
+        memcpy(ctx->mat->_board, ctx->scratch->_board, cells);
+        ctx->sink += matrix_clear_lines(ctx->mat);
+    }
+}
+
+static void setup_update(struct BenchCtx* ctx) {
+    matrix_new_game(ctx->mat, ctx->mat->_nrows, ctx->mat->_ncols, ctx->rng.s[0]);
+}
+
+// a full game tick with a scripted random player: an input most ticks, then the update
+static void run_update(struct BenchCtx* ctx, size_t ops) {
+    Matrix* mat = ctx->mat;
+    for (size_t i = 0; i < ops; i++) {
+        uint32_t roll = rng_below(&ctx->rng, 16);
+        enum Input_t input = roll < INPUT_COUNT - 1 ? (enum Input_t)(roll + 1) : INPUT_NONE;
+        if (input == INPUT_HARD_DROP && rng_below(&ctx->rng, 4) != 0) input = INPUT_SOFT_DROP;
+        bool alive = matrix_apply_input(mat, input) && matrix_update(mat);
+        if (!alive) matrix_new_game(mat, mat->_nrows, mat->_ncols, rng_next(&ctx->rng));
+    }
+    ctx->sink += mat->_points;
+}
+
+// one bot decision at the default depth and beam width, then the move is played through its inputs.
+// No time budget, so every decision does the same amount of work.
+static void run_bot(struct BenchCtx* ctx, size_t ops) {
+    Matrix* mat = ctx->mat;
+    enum Input_t path[4 + 2 * 256];
+    for (size_t i = 0; i < ops; i++) {
+        struct BotMove move;
+        bool alive = bot_think(ctx->bot, mat, &move);
+        size_t len = alive ? bot_move_path(&move, path, ELMCOUNT(path)) : 0;
+        for (size_t k = 0; k < len && alive; k++) alive = matrix_apply_input(mat, path[k]);
+        alive = alive && matrix_update(mat);
+        if (!alive) matrix_new_game(mat, mat->_nrows, mat->_ncols, rng_next(&ctx->rng));
+    }
+    ctx->sink += mat->_points;
+}
+
+// every reachable placement of the current piece, then a random one of them is locked
+static void run_movegen(struct BenchCtx* ctx, size_t ops) {
+    Matrix* mat = ctx->mat;
+    for (size_t i = 0; i < ops; i++) {
+        struct Placement* found;
+        size_t count = movegen_generate(ctx->gen, mat, &found);
+        bool alive = count > 0 && movegen_play(mat, &found[rng_below(&ctx->rng, (uint32_t)count)]);
+        if (!alive) matrix_new_game(mat, mat->_nrows, mat->_ncols, rng_next(&ctx->rng));
+        ctx->sink += count;
+    }
+}
+
+static const struct BenchCase CASES[] = {
+    {"test_tet", setup_any, run_test_tet},
+    {"test_tet_cells", setup_any, run_test_tet_cells},
+    {"paste_unpaste", setup_fitting, run_paste_unpaste},
+    {"rotate_kick_pair", setup_fitting, run_rotate},
+    {"set_hdrop_pos", setup_spawn_area, run_hdrop_pos},
+    {"restore_board", setup_clear, run_restore},
+    {"clear_lines_4", setup_clear, run_clear_lines},
+    {"update_tick", setup_update, run_update},
+    {"bot_think", setup_update, run_bot},
+    {"movegen", setup_update, run_movegen},
+};
+
+// the mask test has to agree with the grid-walking reference everywhere, or the numbers mean nothing
+static bool check_collision(Matrix* mat) {
+    for (int p = 0; p < TETCOUNT; p++) {
+        for (uint8_t r = 0; r < 4; r++) {
+            matrix_set_current_piece(mat, INDEX_TO_PIECE(p), r);
+            for (minopos_t y = -STATE_DIM; y < mat->_nrows + 1; y++) {
+                for (minopos_t x = -STATE_DIM; x < mat->_ncols + 1; x++) {
+                    mat->_tetX = x;
+                    mat->_tetY = y;
+                    if (M_matrix_test_tet(mat) != M_matrix_test_tet_cells(mat)) {
+                        fprintf(stderr, "collision mismatch on %dx%d: piece %d rot %d at (%d, %d)\n",
+                            mat->_ncols, mat->_nrows, p, r, x, y);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// the bot and the move generator move the piece by writing its position, so the cached hard drop row can be stale.
+// Dropping from there still has to stop on the first thing under the piece.
+static bool check_drop(struct BenchCtx* ctx) {
+    Matrix* mat = ctx->mat;
+    gen_fitting_positions(ctx, mat->_nrows);
+    for (size_t i = 0; i + 1 < POSITION_COUNT; i++) {
+        struct BenchPos* from = &ctx->pos[i];
+        struct BenchPos* to = &ctx->pos[i + 1];
+        place(mat, from);
+        M_matrix_paste_tet(mat);
+        M_matrix_set_hdrop_pos(mat);
+        M_matrix_unpaste_tet(mat);
+        mat->_tetX = to->x;
+        mat->_tetY = to->y;
+        mat->_currentRot = to->rot;
+        if (!M_matrix_paste_tet(mat)) continue;
+
+        matrix_drop_rows(mat, mat->_nrows);
+        M_matrix_unpaste_tet(mat);
+        bool fits = M_matrix_test_tet_cells(mat);
+        mat->_tetY++;
+        bool falls = M_matrix_test_tet_cells(mat);
+        mat->_tetY--;
+        if (!fits || falls) {
+            fprintf(stderr, "drop from a stale ghost on %dx%d: piece %d rot %d from (%d, %d) ended %s at (%d, %d)\n",
+                mat->_ncols, mat->_nrows, PIECE_TO_INDEX(from->piece), to->rot, to->x, to->y,
+                fits ? "in the air" : "inside blocks", mat->_tetX, mat->_tetY);
+            return false;
+        }
+    }
+    return true;
+}
+
+// perft counts and the bot's candidates are built on the generator, so everything it lists has to be a real lock
+// position: the piece fits there and can't fall any further
+static bool check_placements(struct BenchCtx* ctx) {
+    Matrix* mat = ctx->mat;
+    Matrix* probe = ctx->scratch;
+    rng_seed(&ctx->rng, 1);
+    matrix_new_game(mat, mat->_nrows, mat->_ncols, rng_next(&ctx->rng));
+    fill_garbage(mat, &ctx->rng);
+    int rounds = PLACEMENT_CELLS / (mat->_nrows * mat->_ncols) + 1;
+    for (int round = 0; round < rounds; round++) {
+        struct Placement* found;
+        size_t count = movegen_generate(ctx->gen, mat, &found);
+        matrix_copy(probe, mat);
+        if (probe->_piecePasted) M_matrix_unpaste_tet(probe);
+        for (size_t i = 0; i < count; i++) {
+            probe->_tetX = found[i].x;
+            probe->_tetY = found[i].y;
+            probe->_currentRot = found[i].rot;
+            bool fits = M_matrix_test_tet(probe);
+            probe->_tetY++;
+            bool falls = M_matrix_test_tet(probe);
+            probe->_tetY--;
+            if (!fits || falls) {
+                fprintf(stderr, "movegen listed piece %d rot %d at (%d, %d) on %dx%d, it %s\n",
+                    PIECE_TO_INDEX(probe->_currentPiece), found[i].rot, found[i].x, found[i].y, mat->_ncols, mat->_nrows,
+                    fits ? "can still fall" : "overlaps the board");
+                return false;
+            }
+        }
+        bool alive = count > 0 && movegen_play(mat, &found[rng_below(&ctx->rng, (uint32_t)count)]);
+        if (!alive) {
+            matrix_new_game(mat, mat->_nrows, mat->_ncols, rng_next(&ctx->rng));
+            fill_garbage(mat, &ctx->rng);
+        }
+    }
+    return true;
+}
+
+// once a game is running nothing allocates, however long it plays and through game overs into new games of the
+// same size. Starting the first one may.
+static bool check_steady_allocs(struct BenchCtx* ctx) {
+    Matrix* mat = ctx->mat;
+    rng_seed(&ctx->rng, 1);
+    matrix_new_game(mat, mat->_nrows, mat->_ncols, rng_next(&ctx->rng));
+    uint64_t before = alloc_count();
+    run_update(ctx, STEADY_TICKS);
+    uint64_t allocs = alloc_count() - before;
+    if (allocs != 0) {
+        fprintf(stderr, "%lu heap allocations in %d ticks of a running game on %dx%d\n",
+            allocs, STEADY_TICKS, mat->_ncols, mat->_nrows);
+        return false;
+    }
+    return true;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+int main(int argc, char** argv) {
+    const char* out_path = DEFAULT_OUTPUT;
+    const char* filter = NULL;
+    int samples = 15;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) samples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) filter = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [-o results.csv] [-s samples] [-f case_name_filter]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (samples < 2) samples = 2;
+
+    parse_game_data();
+    FILE* out = fopen(out_path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "could not open %s\n", out_path);
+        return 1;
+    }
+    fprintf(out, "case,cols,rows,samples,ops_per_sample,mean_ns,stddev_ns,min_ns,median_ns,max_ns,allocs_per_op\n");
+    printf("%-18s %9s %9s %9s %9s %9s\n", "case", "size", "ns/op", "stddev", "min", "allocs/op");
+
+    struct BenchCtx ctx = {0};
+    ctx.mat = matrix_construct();
+    ctx.scratch = matrix_construct();
+    struct BotConfig bot_config;
+    bot_default_config(&bot_config);
+    bot_config.budgetUs = 0;
+    ctx.bot = bot_construct(&bot_config);
+    ctx.gen = movegen_construct();
+    double* sample_ns = (double*)calloc((size_t)samples, sizeof(double));
+
+    for (size_t s = 0; s < ELMCOUNT(BENCH_SIZES); s++) {
+        minopos_t ncols = BENCH_SIZES[s][0], nrows = BENCH_SIZES[s][1];
+        matrix_reset(ctx.mat, nrows, ncols);
+        rng_seed(&ctx.rng, 1);
+        fill_garbage(ctx.mat, &ctx.rng);
+        if (!check_collision(ctx.mat) || !check_drop(&ctx) || !check_placements(&ctx)) return 1;
+        if (!check_steady_allocs(&ctx)) return 1;
+
+        for (size_t c = 0; c < ELMCOUNT(CASES); c++) {
+            const struct BenchCase* bc = &CASES[c];
+            if (filter != NULL && strstr(bc->name, filter) == NULL) continue;
+
+            // same starting point for every case
+            matrix_reset(ctx.mat, nrows, ncols);
+            rng_seed(&ctx.rng, 1);
+            bc->setup(&ctx);
+
+            // calibrate the batch size so one sample takes around SAMPLE_TARGET_NS
+            size_t ops = 16;
+            while (true) {
+                double start = bench_now_ns();
+                bc->run(&ctx, ops);
+                double took = bench_now_ns() - start;
+                if (took > SAMPLE_TARGET_NS / 4 || ops > ((size_t)1 << 30)) {
+                    ops = (size_t)((double)ops * SAMPLE_TARGET_NS / (took > 1 ? took : 1)) + 1;
+                    break;
+                }
+                ops *= 4;
+            }
+
+            double sum = 0;
+            uint64_t allocs_before = alloc_count();
+            for (int i = 0; i < samples; i++) {
+                double start = bench_now_ns();
+                bc->run(&ctx, ops);
+                sample_ns[i] = (bench_now_ns() - start) / (double)ops;
+                sum += sample_ns[i];
+            }
+            double allocs_per_op = (double)(alloc_count() - allocs_before) / ((double)samples * (double)ops);
+            double mean = sum / samples;
+            double var = 0;
+            for (int i = 0; i < samples; i++) var += (sample_ns[i] - mean) * (sample_ns[i] - mean);
+            double stddev = sqrt(var / (samples - 1));
+            qsort(sample_ns, (size_t)samples, sizeof(double), compare_doubles);
+
+            char size_str[16];
+            snprintf(size_str, sizeof(size_str), "%dx%d", ncols, nrows);
+            printf("%-18s %9s %9.2f %9.2f %9.2f %9.3f\n", bc->name, size_str, mean, stddev, sample_ns[0], allocs_per_op);
+            fprintf(out, "%s,%d,%d,%d,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f\n", bc->name, ncols, nrows, samples, ops,
+                mean, stddev, sample_ns[0], sample_ns[samples / 2], sample_ns[samples - 1], allocs_per_op);
+            fflush(stdout);
+        }
+    }
+
+    free(sample_ns);
+    fclose(out);
+    matrix_destruct(ctx.mat);
+    matrix_destruct(ctx.scratch);
+    bot_destruct(ctx.bot);
+    movegen_destruct(ctx.gen);
+    printf("results written to %s\n", out_path);
+    return 0;
+}
@@ -0,0 +1,324 @@
+#include "bot.h"
+
+#include <string.h>
+#include <time.h>
+
+// every rotation state, as the inputs that reach it from spawn
+static const enum Input_t ROTATION_INPUTS[4][2] = {
+    {INPUT_NONE, INPUT_NONE},
+    {INPUT_ROTATE_CW, INPUT_NONE},
+    {INPUT_ROTATE_CW, INPUT_ROTATE_CW},
+    {INPUT_ROTATE_CCW, INPUT_NONE}
+};
+
+// tried after a soft drop, for spins and tucks
+static const enum Input_t FINISH_INPUTS[] = {INPUT_ROTATE_CW, INPUT_ROTATE_CCW, INPUT_LEFT, INPUT_RIGHT};
+
+void bot_default_config(struct BotConfig* config) {
+    config->weights.holes = -8.0f;
+    config->weights.bumpiness = -1.0f;
+    config->weights.height = -0.3f;
+    config->weights.maxHeight = -1.0f;
+    config->weights.wells = -0.5f;
+    config->weights.tSlots = 4.0f;
+    config->weights.points = 0.01f;
+    config->weights.b2b = 2.0f;
+    config->beamWidth = 6;
+    config->depth = 2;
+    config->budgetUs = 2000;
+    config->useHold = true;
+}
+
+struct Bot* bot_construct(const struct BotConfig* config) {
+    struct Bot* bot = (struct Bot*)calloc(1, sizeof(struct Bot));
+    if (bot == NULL) FAIL("Out of memory allocating the bot.\n");
+    bot->config = *config;
+    if (bot->config.beamWidth < 1) bot->config.beamWidth = 1;
+    if (bot->config.beamWidth > BOT_MAX_BEAM) bot->config.beamWidth = BOT_MAX_BEAM;
+    if (bot->config.depth < 1) bot->config.depth = 1;
+    if (bot->config.depth > BOT_MAX_DEPTH) bot->config.depth = BOT_MAX_DEPTH;
+
+    for (int b = 0; b < 2; b++) {
+        for (int i = 0; i < bot->config.beamWidth; i++) bot->beam[b][i] = matrix_construct();
+    }
+    bot->gen = matrix_construct();
+    bot->scratch = matrix_construct();
+    return bot;
+}
+
+void bot_destruct(struct Bot* bot) {
+    if (bot == NULL) return;
+    for (int b = 0; b < 2; b++) {
+        for (int i = 0; i < BOT_MAX_BEAM; i++) matrix_destruct(bot->beam[b][i]);
+    }
+    matrix_destruct(bot->gen);
+    matrix_destruct(bot->scratch);
+    free(bot->moves);
+    free(bot->seen);
+    free(bot);
+}
+
+static uint64_t M_bot_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+}
+
+// whether the cell is filled, counting the walls and floor
+static inline bool M_bot_filled(Matrix* m, int y, int x) {
+    if (x < 0 || x >= m->_ncols || y >= m->_nrows) return true;
+    if (y < 0) return false;
+    return MATRIX_AT(m, y, x).occupied;
+}
+
+float bot_evaluate(const struct BotWeights* weights, Matrix* this) {
+    bool pasted = this->_piecePasted;
+    if (pasted) M_matrix_unpaste_tet(this);
+
+    // holes straight off the bitboard: every empty bit with a filled one somewhere above it
+    uint32_t holes = 0;
+    for (size_t w = 0; w < this->_bbStride; w++) {
+        bbword_t covered = 0;
+        for (minopos_t y = 0; y < this->_nrows; y++) {
+            bbword_t row = this->_bits[(size_t)y * this->_bbStride + w];
+            holes += (uint32_t)__builtin_popcountll(covered & ~row);
+            covered |= row;
+        }
+    }
+
+    int32_t height_sum = 0, max_height = 0, bumpiness = 0, wells = 0, tslots = 0;
+    for (minopos_t x = 0; x < this->_ncols; x++) {
+        int32_t h = this->_nrows - this->_colTop[x];
+        height_sum += h;
+        if (h > max_height) max_height = h;
+
+        int32_t left = x > 0 ? this->_nrows - this->_colTop[x - 1] : INT32_MAX;
+        int32_t right = x < this->_ncols - 1 ? this->_nrows - this->_colTop[x + 1] : INT32_MAX;
+        if (x > 0) bumpiness += left > h ? left - h : h - left;
+        int32_t depth = (left < right ? left : right) - h;
+        if (depth > 0) wells += depth * (depth + 1) / 2;
+
+        // T-spin double slot centered on this column: the stem goes in the top empty cell,
+        // the bar in the row above it, under a roof on one side
+        int y = this->_colTop[x] - 2;
+        if (x > 0 && x < this->_ncols - 1 && y >= 1
+            && !M_bot_filled(this, y, x - 1) && !M_bot_filled(this, y, x + 1)
+            && M_bot_filled(this, y + 1, x - 1) && M_bot_filled(this, y + 1, x + 1)
+            && (M_bot_filled(this, y - 1, x - 1) != M_bot_filled(this, y - 1, x + 1)))
+            tslots++;
+    }
+
+    if (pasted) M_matrix_paste_tet(this);
+
+    return weights->holes * (float)holes
+        + weights->bumpiness * (float)bumpiness
+        + weights->height * (float)height_sum
+        + weights->maxHeight * (float)max_height
+        + weights->wells * (float)wells
+        + weights->tSlots * (float)tslots;
+}
+
+// puts the current piece of `m` somewhere it fits
+static void M_bot_move_piece(Matrix* m, minopos_t x, minopos_t y, uint8_t rot) {
+    M_matrix_unpaste_tet(m);
+    m->_tetX = x;
+    m->_tetY = y;
+    m->_currentRot = rot;
+    m->_hdropDirty = true;
+    M_matrix_paste_tet(m);
+}
+
+// records the placement the current position of `bot->gen` drops to, unless it's already known
+static void M_bot_add_move(struct Bot* bot, size_t* count, struct BotMove* move) {
+    Matrix* gen = bot->gen;
+    M_matrix_set_hdrop_pos(gen);
+    move->x = gen->_hdropX;
+    move->y = gen->_hdropY;
+    move->rot = gen->_currentRot;
+
+    size_t w = (size_t)gen->_ncols + STATE_DIM;
+    size_t h = (size_t)gen->_nrows + STATE_DIM;
+    size_t key = (((size_t)move->hold * 4 + move->rot) * h + (size_t)(move->y + STATE_DIM)) * w + (size_t)(move->x + STATE_DIM);
+    if (bot->seen[key] == bot->stamp) return;
+    bot->seen[key] = bot->stamp;
+    bot->moves[(*count)++] = *move;
+}
+
+// whether anything around columns [x - 1, x + STATE_DIM] overhangs, only then are spins and tucks worth trying
+static bool M_bot_near_overhang(Matrix* m, minopos_t x) {
+    for (minopos_t c = (minopos_t)(x - 1); c <= x + STATE_DIM; c++) {
+        if (c >= 0 && c < m->_ncols && m->_colHole[c] >= 0) return true;
+    }
+    return false;
+}
+
+// every placement reachable from spawn by rotating, sliding, then either hard dropping or soft dropping and one more move
+static void M_bot_generate(struct Bot* bot, Matrix* src, bool hold, size_t* count) {
+    Matrix* gen = bot->gen;
+    matrix_copy(gen, src);
+    if (hold && (!gen->_holdAllowable || !matrix_hold_piece(gen))) return;
+
+    minopos_t spawn_x = gen->_tetX, spawn_y = gen->_tetY;
+    uint8_t spawn_rot = gen->_currentRot;
+    for (uint8_t r = 0; r < 4; r++) {
+        M_bot_move_piece(gen, spawn_x, spawn_y, spawn_rot);
+        bool rotated = true;
+        for (int i = 0; i < 2 && ROTATION_INPUTS[r][i] != INPUT_NONE; i++)
+            rotated = rotated && matrix_rotate_piece(gen, ROTATION_INPUTS[r][i] == INPUT_ROTATE_CW ? 1 : -1);
+        if (!rotated) continue;
+
+        minopos_t base_x = gen->_tetX, base_y = gen->_tetY;
+        uint8_t base_rot = gen->_currentRot;
+        for (int8_t dir = -1; dir <= 1; dir += 2) {
+            M_bot_move_piece(gen, base_x, base_y, base_rot);
+            int16_t shift = 0;
+            while (true) {
+                // the unshifted position is shared by both directions
+                if (dir < 0 || shift != 0) {
+                    struct BotMove move = {hold, r, shift, -1, INPUT_NONE, 0, 0, 0};
+                    M_bot_add_move(bot, count, &move);
+
+                    if (M_bot_near_overhang(gen, gen->_tetX)) {
+                        minopos_t slide_x = gen->_tetX, slide_y = gen->_tetY;
+                        int16_t drops = 0;
+                        while (true) {
+                            minopos_t before = gen->_tetY;
+                            matrix_drop_rows(gen, 1);
+                            if (gen->_tetY == before) break;
+                            drops++;
+                        }
+                        minopos_t land_y = gen->_tetY;
+                        for (size_t f = 0; f < ELMCOUNT(FINISH_INPUTS); f++) {
+                            matrix_apply_input(gen, FINISH_INPUTS[f]);
+                            if (gen->_tetX != slide_x || gen->_tetY != land_y || gen->_currentRot != base_rot) {
+                                struct BotMove spin = {hold, r, shift, drops, (uint8_t)FINISH_INPUTS[f], 0, 0, 0};
+                                M_bot_add_move(bot, count, &spin);
+                                M_bot_move_piece(gen, slide_x, land_y, base_rot);
+                            }
+                        }
+                        M_bot_move_piece(gen, slide_x, slide_y, base_rot);
+                    }
+                }
+                if (!matrix_slide_piece(gen, dir)) break;
+                shift = (int16_t)(shift + dir);
+            }
+        }
+    }
+}
+
+// all placements of the current piece of `src`, held piece included
+static size_t M_bot_generate_all(struct Bot* bot, Matrix* src) {
+    // at most one placement per (hold, rotation, position), grown for the biggest board seen
+    size_t slots = 2 * 4 * ((size_t)src->_nrows + STATE_DIM) * ((size_t)src->_ncols + STATE_DIM);
+    if (slots > bot->seenCap) {
+        free(bot->seen);
+        free(bot->moves);
+        bot->seen = (uint32_t*)calloc(slots, sizeof(uint32_t));
+        bot->moves = (struct BotMove*)malloc(slots * sizeof(struct BotMove));
+        if (bot->seen == NULL || bot->moves == NULL) FAIL("Out of memory allocating the bot's move list.\n");
+        bot->seenCap = slots;
+        bot->movesCap = slots;
+        bot->stamp = 0;
+    }
+    bot->stamp++;
+    if (bot->stamp == 0) { // wrapped, old stamps could collide
+        memset(bot->seen, 0, bot->seenCap * sizeof(uint32_t));
+        bot->stamp = 1;
+    }
+
+    size_t count = 0;
+    M_bot_generate(bot, src, false, &count);
+    if (bot->config.useHold) M_bot_generate(bot, src, true, &count);
+    return count;
+}
+
+// play a placement straight into its final position. Locking scores and spins only depend on where the piece ends up.
+static bool M_bot_apply(Matrix* m, const struct BotMove* move) {
+    if (move->hold && !matrix_hold_piece(m)) return false;
+    M_bot_move_piece(m, move->x, move->y, move->rot);
+    return M_matrix_lock(m);
+}
+
+bool bot_think(struct Bot* bot, Matrix* game, struct BotMove* move) {
+    uint64_t deadline = M_bot_now_us() + bot->config.budgetUs;
+    const struct BotWeights* weights = &bot->config.weights;
+    memset(&bot->stats, 0, sizeof(bot->stats));
+
+    int cur = 0;
+    uint8_t width = 1;
+    matrix_copy(bot->beam[cur][0], game);
+    bool found = false;
+
+    for (uint8_t depth = 0; depth < bot->config.depth; depth++) {
+        struct BotNode* next = bot->nodes[1 - cur];
+        uint8_t next_width = 0;
+
+        for (uint8_t i = 0; i < width; i++) {
+            Matrix* parent = bot->beam[cur][i];
+            size_t count = M_bot_generate_all(bot, parent);
+            bot->stats.placements += (uint32_t)count;
+
+            for (size_t m = 0; m < count; m++) {
+                Matrix* child = bot->scratch;
+                matrix_copy(child, parent);
+                if (!M_bot_apply(child, &bot->moves[m])) continue; // topped out
+
+                float value = bot_evaluate(weights, child)
+                    + weights->points * (float)(child->_points - game->_points)
+                    + weights->b2b * (float)child->_b2b;
+
+                // keep the best `beamWidth`, sorted best first
+                if (next_width == bot->config.beamWidth && value <= next[next_width - 1].value) continue;
+                uint8_t at = next_width < bot->config.beamWidth ? next_width++ : (uint8_t)(next_width - 1);
+                while (at > 0 && next[at - 1].value < value) {
+                    next[at] = next[at - 1];
+                    at--;
+                }
+                next[at].value = value;
+                next[at].parent = i;
+                next[at].move = bot->moves[m];
+                next[at].root = depth == 0 ? bot->moves[m] : bot->nodes[cur][i].root;
+            }
+            // the first depth always finishes, so there is a move to return
+            if (i + 1 < width && depth > 0 && bot->config.budgetUs > 0 && M_bot_now_us() > deadline) {
+                bot->stats.budgetHit = true;
+                break;
+            }
+        }
+        // a depth cut short only saw the children of the first few parents, the last complete depth's answer stands
+        if (next_width == 0 || bot->stats.budgetHit) break;
+
+        // the best of this depth is the answer unless a deeper one completes
+        *move = next[0].root;
+        found = true;
+        bot->stats.depthReached = (uint8_t)(depth + 1);
+        if (depth + 1 == bot->config.depth) break;
+        if (bot->config.budgetUs > 0 && M_bot_now_us() > deadline) {
+            bot->stats.budgetHit = true;
+            break;
+        }
+
+        for (uint8_t k = 0; k < next_width; k++) {
+            matrix_copy(bot->beam[1 - cur][k], bot->beam[cur][next[k].parent]);
+            M_bot_apply(bot->beam[1 - cur][k], &next[k].move);
+        }
+        cur = 1 - cur;
+        width = next_width;
+    }
+    return found;
+}
+
+size_t bot_move_path(const struct BotMove* move, enum Input_t* path, size_t cap) {
+    size_t n = 0;
+    #define PUSH(input) do { if (n < cap) path[n++] = (input); } while (0)
+    if (move->hold) PUSH(INPUT_HOLD);
+    for (int i = 0; i < 2 && ROTATION_INPUTS[move->rotations][i] != INPUT_NONE; i++) PUSH(ROTATION_INPUTS[move->rotations][i]);
+    for (int16_t s = 0; s < (move->shift < 0 ? -move->shift : move->shift); s++) PUSH(move->shift < 0 ? INPUT_LEFT : INPUT_RIGHT);
+    if (move->softDrops >= 0) {
+        for (int16_t d = 0; d < move->softDrops; d++) PUSH(INPUT_SOFT_DROP);
+        PUSH((enum Input_t)move->finish);
+    }
+    PUSH(INPUT_HARD_DROP);
+    #undef PUSH
+    return n;
+}
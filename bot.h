@@ -0,0 +1,119 @@
+#ifndef BOT_H
+#define BOT_H
+// Placement search bot. Moves are found and played out with the same Matrix functions a player's inputs go through,
+// so every placement it picks, spins included, is reachable in the real game.
+
+#include "matrix.h"
+
+#define BOT_MAX_BEAM 32
+#define BOT_MAX_DEPTH 8
+
+// weights of the evaluation, the bot picks the placement that maximizes the weighted sum
+struct BotWeights {
+    float holes; // empty cells under a filled one
+    float bumpiness; // sum of height differences between neighbouring columns
+    float height; // sum of column heights
+    float maxHeight; // height of the tallest column
+    float wells; // 1 + 2 + ... + depth, for every column lower than both of its neighbours
+    float tSlots; // T-spin double shaped slots waiting for a T
+    float points; // score gained on the way there, as counted by `M_matrix_add_score`
+    float b2b; // back-to-back streak at the end of the search
+};
+
+struct BotConfig {
+    struct BotWeights weights;
+    uint8_t beamWidth; // states kept per depth, at most BOT_MAX_BEAM
+    uint8_t depth; // pieces searched ahead, from 1 to BOT_MAX_DEPTH
+    uint32_t budgetUs; // search time per decision, 0 for none. Always finishes the first depth.
+    bool useHold;
+};
+
+// one way to place the current piece. `bot_move_path` turns it into inputs.
+struct BotMove {
+    bool hold;
+    uint8_t rotations; // 0: none, 1: CW, 2: CW twice, 3: CCW
+    int16_t shift; // slides, negative to the left
+    int16_t softDrops; // soft drops before `finish`, -1 to hard drop right after sliding
+    uint8_t finish; // enum Input_t after soft dropping, a rotation or slide for spins and tucks
+    // where the piece locks
+    minopos_t x, y;
+    uint8_t rot;
+};
+
+struct BotStats {
+    uint32_t placements; // placements generated and evaluated
+    uint8_t depthReached; // last depth searched completely, the move comes from it
+    bool budgetHit;
+};
+
+// a state kept in the beam, and the first move that led to it
+struct BotNode {
+    float value;
+    struct BotMove root;
+    uint8_t parent;
+    struct BotMove move;
+};
+
+struct Bot {
+    struct BotConfig config;
+    struct BotStats stats;
+
+    Matrix* beam[2][BOT_MAX_BEAM];
+    struct BotNode nodes[2][BOT_MAX_BEAM];
+    Matrix* gen; // walks the piece around to find placements
+    Matrix* scratch; // placements are tried here
+
+    struct BotMove* moves; // placements of the node being expanded
+    size_t movesCap;
+    uint32_t* seen; // stamp per (hold, rot, y, x), a placement is new if its stamp is old
+    size_t seenCap;
+    uint32_t stamp;
+};
+
+/**
+ * The weights and search settings the bot uses unless told otherwise.
+ * @param config Filled in.
+ */
+void bot_default_config(struct BotConfig* config);
+
+/**
+ * Create a bot. Its buffers grow to the largest board it sees, after that deciding doesn't allocate.
+ * @param config Search settings, copied.
+ * @returns A heap allocated bot, free with `bot_destruct`.
+ */
+struct Bot* bot_construct(const struct BotConfig* config);
+
+/**
+ * Free a bot and everything it owns.
+ * @param bot The bot, may be NULL.
+ */
+void bot_destruct(struct Bot* bot);
+
+/**
+ * Pick a placement for the current piece of a game. The game isn't modified.
+ * @param bot The bot.
+ * @param game The game to play. Needs a current piece.
+ * @param move Receives the chosen placement.
+ * @returns `false` if every placement tops out.
+ */
+bool bot_think(struct Bot* bot, Matrix* game, struct BotMove* move);
+
+/**
+ * Spell a placement out as the inputs that play it. Applying them with `matrix_apply_input` followed by one
+ * `matrix_update` for the queued hard drop locks the piece where `bot_think` planned.
+ * @param move A placement from `bot_think`.
+ * @param path Receives the inputs.
+ * @param cap Size of `path`. `4 + ncols + nrows` is always enough.
+ * @returns Number of inputs written.
+ */
+size_t bot_move_path(const struct BotMove* move, enum Input_t* path, size_t cap);
+
+/**
+ * Score a board with the evaluation weights, leaving out the current piece.
+ * @param weights Evaluation weights.
+ * @param this The board to score. Left as it was.
+ * @returns Higher is better.
+ */
+float bot_evaluate(const struct BotWeights* weights, Matrix*);
+
+#endif
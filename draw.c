@@ -0,0 +1,577 @@
+#include "draw.h"
+
+#include <langinfo.h>
+#include <locale.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ansiterm.h"
+
+// screen area in characters, [top, bottom) x [left, right)
+struct ScreenRect {
+    int top, left, bottom, right;
+};
+
+// glyphs a board cell can show besides the piece types
+#define GLYPH_BG (GARBAGE + 1)
+#define GLYPH_SPAWN (GARBAGE + 2)
+#define GLYPH_GHOST (GARBAGE + 3)
+#define GLYPH_UNKNOWN 0xff // forces a redraw
+
+#define CURSES_MAX_PAIRS 126 // each pair redefines two of the 256 palette colors
+#define ANSI_MAX_PAIRS 255
+#define PAIR_CACHE_SLOTS 512 // power of two, over twice as many as there can be pairs
+#define UPPER_HALF_UTF8 "\xe2\x96\x80"
+_Static_assert(DRAW_UPPER_HALF == ANSITERM_UPPER_HALF, "the ANSI writer is handed the glyph as is");
+
+#define STATS_LINES 6
+#define STATS_WIDTH 48
+#define COMBO_TEXT_HALF 10 // half the width of the longest combo name, rounded up
+#define COMBO_ANIM_MS 3200 // combo text shows this long after a clear
+
+// a pair made by draw_pair_for
+struct PairCacheSlot {
+    uint16_t fg, bg;
+    ColorPair_t pair; // 0 for an empty slot
+};
+
+// what the last `matrix_draw` put on screen, so the next one only touches what changed
+struct DrawCache {
+    bool valid;
+    int left, width, winy; // screen area the layout was made for
+    minopos_t nrows, ncols;
+
+    uint8_t* shown; // one glyph per board cell, row-major
+    size_t shownCap;
+
+    minopos_t ghostX, ghostY;
+    uint8_t ghostRot;
+    enum TetrominoType_t ghostPiece;
+
+    bool holdValid;
+    enum TetrominoType_t heldPiece;
+    uint8_t heldRot;
+
+    char stats[STATS_LINES][64];
+    bool comboShown;
+    bool halfBlocks; // layout the cache was made for
+};
+
+// what a color pair looks like, for the ANSI writer
+struct PairColors {
+    uint32_t fg, bg; // 0xRRGGBB
+};
+
+struct ColorSet GAME_COLORS;
+enum DrawBackend_t draw_backend = DRAW_CURSES;
+static struct PairColors pair_colors[ANSI_MAX_PAIRS + 1] = {[0] = {ANSITERM_DEFAULT_COLOR, ANSITERM_DEFAULT_COLOR}};
+static ColorPair_t current_pair = 0; // set by draw_color_on, for the ANSI writer
+static int palette_back = 2; // next pair to make. Only really works when set to 2 initially.
+static int first_cached_pair = 0; // pairs from here up are draw_pair_for's, 0 until it made one
+static struct PairCacheSlot pair_cache[PAIR_CACHE_SLOTS] = {0};
+bool draw_half_blocks = false;
+bool draw_combo_shutter = true;
+static struct DrawCache draw_caches[DRAW_VIEWS] = {0};
+static struct ScreenRect panel_rects[DRAW_VIEWS] = {0}; // empty outside of games
+
+// allocates two color slots from the global state, for fg/bg color. returns pair number
+uint8_t set_rgb_pair(uint8_t fr, uint8_t fb, uint8_t fg, uint8_t br, uint8_t bg, uint8_t bb) {
+    ColorPair_t S_palette_back = (ColorPair_t)palette_back;
+    if (palette_back >= (draw_backend == DRAW_CURSES ? CURSES_MAX_PAIRS : ANSI_MAX_PAIRS)) FAIL("Too many color pairs created!\n");
+    palette_back++;
+
+    // same channel order init_color gets below
+    pair_colors[S_palette_back].fg = (uint32_t)fr << 16 | (uint32_t)fg << 8 | fb;
+    pair_colors[S_palette_back].bg = (uint32_t)br << 16 | (uint32_t)bg << 8 | bb;
+    if (draw_backend == DRAW_ANSI) return S_palette_back;
+
+    int err_ret;
+    // set fg/bg color to make a pair
+    err_ret = init_color((short)(S_palette_back * 2 + 0), C_RESCALE(fr), C_RESCALE(fg), C_RESCALE(fb));
+    if (err_ret == ERR) FAILF("init_color for fg failed, for one reason or another. (paletteno = %d)\n", S_palette_back);
+     
+    err_ret = init_color((short)(S_palette_back * 2 + 1), C_RESCALE(br), C_RESCALE(bg), C_RESCALE(bb));
+    if (err_ret == ERR) FAILF("init_color for bg failed, for one reason or another. (paletteno = %d)\n", S_palette_back);
+
+    err_ret = init_pair(S_palette_back, (short)(S_palette_back * 2 + 0), (short)(S_palette_back * 2 + 1));
+    if (err_ret == ERR) FAILF("init_pair failed, for one reason or another. (paletteno = %d)\n", S_palette_back);
+
+    return S_palette_back;
+}
+
+bool draw_setup_locale() {
+    setlocale(LC_CTYPE, ""); // only the character set, numbers keep printing with a '.'
+    return !draw_half_blocks || draw_backend != DRAW_CURSES || strcmp(nl_langinfo(CODESET), "UTF-8") == 0;
+}
+
+static uint32_t M_palette_rgb(uint16_t color) {
+    struct PairColors* pair = &pair_colors[color / 2];
+    return color % 2 ? pair->bg : pair->fg;
+}
+
+ColorPair_t draw_pair_for(uint16_t fg, uint16_t bg) {
+    size_t home = ((size_t)fg * 31u + bg) & (PAIR_CACHE_SLOTS - 1);
+    size_t slot = home;
+    while (pair_cache[slot].pair != 0) {
+        if (pair_cache[slot].fg == fg && pair_cache[slot].bg == bg) return pair_cache[slot].pair;
+        slot = (slot + 1) & (PAIR_CACHE_SLOTS - 1);
+    }
+
+    if (first_cached_pair == 0) first_cached_pair = palette_back;
+    int max_pairs = draw_backend == DRAW_CURSES && COLOR_PAIRS < ANSI_MAX_PAIRS + 1 ? COLOR_PAIRS : ANSI_MAX_PAIRS + 1;
+    if (palette_back >= max_pairs) {
+        // start over. Whatever still shows the old pairs is repainted with new ones next frame.
+        memset(pair_cache, 0, sizeof(pair_cache));
+        palette_back = first_cached_pair;
+        slot = home;
+        draw_invalidate();
+        if (palette_back >= max_pairs) FAIL("No color pairs left for the half-block colors.\n");
+    }
+    ColorPair_t pair = (ColorPair_t)palette_back++;
+    if (draw_backend == DRAW_CURSES && init_pair(pair, (short)fg, (short)bg) == ERR)
+        FAILF("init_pair failed, for one reason or another. (paletteno = %d)\n", pair);
+    pair_colors[pair].fg = M_palette_rgb(fg);
+    pair_colors[pair].bg = M_palette_rgb(bg);
+    pair_cache[slot] = (struct PairCacheSlot){fg, bg, pair};
+    return pair;
+}
+
+bool draw_backend_parse(const char* name, enum DrawBackend_t* out) {
+    if (strcmp(name, "curses") == 0) *out = DRAW_CURSES;
+    else if (strcmp(name, "ansi") == 0) *out = DRAW_ANSI;
+    else return false;
+    return true;
+}
+
+void init_palette() {
+    GAME_COLORS.DEFAULT = set_rgb_pair(0xff, 0xff, 0xff, 0, 0, 0);
+    GAME_COLORS.DEFAULT_INV = set_rgb_pair(0, 0, 0, 0xff, 0xff, 0xff);
+    GAME_COLORS.I_PIECE = set_rgb_pair(SOLID(0x42, 0xe6, 0xf5));
+    GAME_COLORS.J_PIECE = set_rgb_pair(SOLID(0x35, 0x38, 0xcc));
+    GAME_COLORS.L_PIECE = set_rgb_pair(SOLID(0xe8, 0xcf, 0x4f));
+    GAME_COLORS.O_PIECE = set_rgb_pair(SOLID(0xea, 0xed, 0x15));
+    GAME_COLORS.T_PIECE = set_rgb_pair(SOLID(0xa7, 0x1f, 0xe0));
+    GAME_COLORS.S_PIECE = set_rgb_pair(SOLID(0x46, 0xe0, 0x1f));
+    GAME_COLORS.Z_PIECE = set_rgb_pair(SOLID(0xe3, 0x22, 0x22));
+    GAME_COLORS.GARBAGE_PIECE = set_rgb_pair(SOLID(0x77, 0x77, 0x77));
+    GAME_COLORS.BG = set_rgb_pair(SOLID(0x22, 0x22, 0x22));
+    GAME_COLORS.SPAWN_ZONE = set_rgb_pair(SOLID(0x11, 0x22, 0x11));
+    GAME_COLORS.GHOST = set_rgb_pair(0xcc, 0xcc, 0xcc, 0x27, 0x27, 0x27);
+    GAME_COLORS.GOLDEN = set_rgb_pair(0, 0, 0, 249, 209, 47);
+    GAME_COLORS.METEOR = set_rgb_pair(SOLID(2, 2, 23));
+    GAME_COLORS.METEOR2 = set_rgb_pair(SOLID(6, 2, 30));
+}
+
+ColorPair_t toPieceColor(enum TetrominoType_t piece) {
+    switch (piece) {
+        case I: return GAME_COLORS.I_PIECE;
+        case J: return GAME_COLORS.J_PIECE;
+        case L: return GAME_COLORS.L_PIECE;
+        case O: return GAME_COLORS.O_PIECE;
+        case T: return GAME_COLORS.T_PIECE;
+        case S: return GAME_COLORS.S_PIECE;
+        case Z: return GAME_COLORS.Z_PIECE;
+        case GARBAGE: return GAME_COLORS.GARBAGE_PIECE;
+        default: return GAME_COLORS.DEFAULT;
+    }
+}
+
+void draw_color_on(ColorPair_t pair) {
+    if (draw_backend == DRAW_CURSES) attron(COLOR_PAIR(pair));
+    else current_pair = pair;
+}
+
+void draw_color_off(ColorPair_t pair) {
+    if (draw_backend == DRAW_CURSES) attroff(COLOR_PAIR(pair));
+    else current_pair = 0;
+}
+
+void draw_addnstr(int y, int x, const char* str, int n) {
+    if (draw_backend == DRAW_CURSES) {
+        // ▀ is three bytes, curses works out its width from the locale
+        move(y, x);
+        int start = 0, i = 0;
+        for (; (n < 0 || i < n) && str[i] != '\0'; i++) {
+            if (str[i] != DRAW_UPPER_HALF) continue;
+            if (i > start) addnstr(str + start, i - start);
+            addstr(UPPER_HALF_UTF8);
+            start = i + 1;
+        }
+        if (i > start) addnstr(str + start, i - start);
+        return;
+    }
+    int rows, cols;
+    getmaxyx(stdscr, rows, cols);
+    ansiterm_resize(rows, cols);
+    int len = 0;
+    while ((n < 0 || len < n) && str[len] != '\0') len++;
+    ansiterm_put(y, x, str, len, pair_colors[current_pair].fg, pair_colors[current_pair].bg);
+}
+
+void draw_addstr(int y, int x, const char* str) {
+    draw_addnstr(y, x, str, -1);
+}
+
+void draw_addch(int y, int x, char c) {
+    draw_addnstr(y, x, &c, 1);
+}
+
+void draw_printw(int y, int x, const char* fmt, ...) {
+    char text[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    draw_addstr(y, x, text);
+}
+
+void draw_erase() {
+    if (draw_backend == DRAW_CURSES) {
+        erase();
+        return;
+    }
+    int rows, cols;
+    getmaxyx(stdscr, rows, cols);
+    ansiterm_resize(rows, cols);
+    ansiterm_erase();
+}
+
+void draw_present() {
+    if (draw_backend == DRAW_CURSES) {
+        refresh();
+        return;
+    }
+    int rows, cols;
+    getmaxyx(stdscr, rows, cols);
+    ansiterm_resize(rows, cols);
+    ansiterm_present(STDOUT_FILENO);
+}
+
+void draw_text_centered(int x_cent, int y_cent, const char* str) {
+    size_t len = strlen(str);
+    int x_start = x_cent - (int)len / 2;
+    draw_addstr(y_cent, x_start, str);
+}
+
+bool in_panel(int y, int x) {
+    for (int v = 0; v < DRAW_VIEWS; v++) {
+        struct ScreenRect* r = &panel_rects[v];
+        if (y >= r->top && y < r->bottom && x >= r->left && x < r->right) return true;
+    }
+    return false;
+}
+
+void draw_run_put(struct DrawRun* run, int y, int x, ColorPair_t pair, char c) {
+    if (run->len > 0 && (y != run->y || x != run->x + run->len || pair != run->pair || run->len == RUN_MAX))
+        draw_run_flush(run);
+    if (run->len == 0) {
+        run->y = y;
+        run->x = x;
+        run->pair = pair;
+    }
+    run->text[run->len++] = c;
+}
+
+void draw_run_flush(struct DrawRun* run) {
+    if (run->len == 0) return;
+    COLOR(run->pair, draw_addnstr(run->y, run->x, run->text, run->len));
+    run->len = 0;
+}
+
+void draw_release_panel() {
+    for (int v = 0; v < DRAW_VIEWS; v++) panel_rects[v] = (struct ScreenRect){0};
+}
+
+void draw_invalidate() {
+    for (int v = 0; v < DRAW_VIEWS; v++) draw_caches[v].valid = false;
+}
+
+void draw_free() {
+    for (int v = 0; v < DRAW_VIEWS; v++) {
+        free(draw_caches[v].shown);
+        draw_caches[v].shown = NULL;
+        draw_caches[v].shownCap = 0;
+    }
+    ansiterm_free();
+}
+
+// what a board cell should look like right now
+static uint8_t M_board_glyph(Matrix* this, minopos_t y, minopos_t x) {
+    struct Mino* mino = &MATRIX_AT(this, y, x);
+    if (mino->occupied) return mino->type;
+
+    minopos_t ghost_local_x = (minopos_t)(x - this->_hdropX);
+    minopos_t ghost_local_y = (minopos_t)(y - this->_hdropY);
+    if (this->_currentPiece != INVALID && ghost_local_x >= 0 && ghost_local_x < STATE_DIM && ghost_local_y >= 0 && ghost_local_y < STATE_DIM) {
+        if (TMask[PIECE_TO_INDEX(this->_currentPiece)][this->_currentRot].rows[ghost_local_y] & (1u << ghost_local_x))
+            return GLYPH_GHOST;
+    }
+    return y >= STATE_DIM + this->_rootY ? GLYPH_BG : GLYPH_SPAWN;
+}
+
+static ColorPair_t M_glyph_pair(uint8_t glyph) {
+    switch (glyph) {
+        case GLYPH_BG: return GAME_COLORS.BG;
+        case GLYPH_SPAWN: return GAME_COLORS.SPAWN_ZONE;
+        case GLYPH_GHOST: return GAME_COLORS.GHOST;
+        default: return toPieceColor((enum TetrominoType_t)glyph);
+    }
+}
+
+// queue both characters of a square cell
+static void M_run_put_sq(struct DrawRun* run, int y, int x, ColorPair_t pair, char c) {
+    draw_run_put(run, y, x * 2, pair, c);
+    draw_run_put(run, y, x * 2 + 1, pair, c);
+}
+
+// what a board glyph looks like as one half of a half-block cell
+static uint16_t M_glyph_color(uint8_t glyph) {
+    if (glyph == GLYPH_GHOST) return DRAW_FG_OF(GAME_COLORS.GHOST);
+    return DRAW_BG_OF(M_glyph_pair(glyph));
+}
+
+// color of a cell of the hold box, counted from its top left corner including the border
+static ColorPair_t M_hold_pair(Matrix* this, int y, int x) {
+    minopos_t held_local_x = (minopos_t)(x - 1);
+    minopos_t held_local_y = (minopos_t)(y - 1);
+    if (this->_heldPiece == INVALID || held_local_x >= STATE_DIM || held_local_y >= STATE_DIM || held_local_x < 0 || held_local_y < 0)
+        return GAME_COLORS.BG;
+    bool occupied = TMask[PIECE_TO_INDEX(this->_heldPiece)][this->_currentRot].rows[held_local_y] & (1u << held_local_x);
+    return occupied ? toPieceColor(this->_heldPiece) : GAME_COLORS.BG;
+}
+
+// queue a half-block cell showing two colors stacked
+static void M_run_put_half(struct DrawRun* run, int y, int x, uint16_t top, uint16_t bottom) {
+    if (top == bottom) draw_run_put(run, y, x, draw_pair_for(bottom, bottom), ' ');
+    else draw_run_put(run, y, x, draw_pair_for(top, bottom), DRAW_UPPER_HALF);
+}
+
+// how long ago the last combo scored
+static uint64_t M_combo_anim_ms(Matrix* this) {
+    return (uint64_t)this->_comboAnimTimer * MATRIX_TICK_US / 1000;
+}
+
+bool matrix_draw_needed(Matrix* this) {
+    return matrix_draw_view_needed(this, 0, 0, getmaxx(stdscr));
+}
+
+bool matrix_draw_view_needed(Matrix* this, int view, int left, int width) {
+    struct DrawCache* cache = &draw_caches[view];
+    int winy = getmaxy(stdscr);
+    if (!cache->valid || cache->left != left || cache->width != width || cache->winy != winy || cache->nrows != this->_nrows
+        || cache->ncols != this->_ncols || cache->halfBlocks != draw_half_blocks) return true;
+    // stats only change on a lock, which damages the board
+    if (this->_damageTop < this->_damageBottom) return true;
+    if (cache->ghostX != this->_hdropX || cache->ghostY != this->_hdropY
+        || cache->ghostRot != this->_currentRot || cache->ghostPiece != this->_currentPiece) return true;
+    if (!cache->holdValid || cache->heldPiece != this->_heldPiece || cache->heldRot != this->_currentRot) return true;
+    return M_combo_anim_ms(this) < COMBO_ANIM_MS || cache->comboShown;
+}
+
+void matrix_draw(Matrix* this) {
+    matrix_draw_view(this, 0, 0, getmaxx(stdscr));
+}
+
+void matrix_draw_view(Matrix* this, int view, int left, int width) {
+    struct DrawCache* cache = &draw_caches[view];
+    struct ScreenRect* panel = &panel_rects[view];
+    int winy = getmaxy(stdscr);
+    int right = left + width; // one past the last column of the view
+    int winx = left + width / 2; // center column
+    
+    // everything below is in screen characters. Square cells are two characters across, half-block cells one
+    // character across and half a row tall.
+    int cell_w = draw_half_blocks ? 1 : 2;
+    int rows_per_line = draw_half_blocks ? 2 : 1; // board rows in one screen row
+    int board_rows = (this->_nrows + rows_per_line - 1) / rows_per_line;
+    int hold_w = (STATE_DIM + 2) * cell_w;
+    int hold_rows = (STATE_DIM + 2 + rows_per_line - 1) / rows_per_line;
+    int startx = (winx / cell_w - this->_ncols / 2) * cell_w;
+    int starty = (winy / 2) - (board_rows / 2);
+    int statsx = startx + this->_ncols * cell_w + 2;
+    int holdx = startx + (this->_ncols + 2) * cell_w;
+
+    bool too_short_flag = starty < 0 || starty + board_rows - 1 > winy - 3;
+    bool too_narrow_flag = startx < left || holdx + hold_w + 2 * cell_w > right;
+
+    minopos_t dirty_top, dirty_bottom;
+    matrix_take_damage(this, &dirty_top, &dirty_bottom);
+
+    if (!cache->valid || cache->left != left || cache->width != width || cache->winy != winy
+        || cache->nrows != this->_nrows || cache->ncols != this->_ncols || cache->halfBlocks != draw_half_blocks) {
+        size_t cell_count = (size_t)this->_nrows * (size_t)this->_ncols;
+        if (cell_count > cache->shownCap) {
+            free(cache->shown);
+            cache->shown = (uint8_t*)malloc(cell_count);
+            if (cache->shown == NULL) FAIL("Out of memory allocating the draw cache.\n");
+            cache->shownCap = cell_count;
+        }
+        memset(cache->shown, GLYPH_UNKNOWN, cell_count);
+        memset(cache->stats, 0, sizeof(cache->stats));
+        cache->holdValid = false;
+        cache->comboShown = false;
+        cache->left = left;
+        cache->width = width;
+        cache->winy = winy;
+        cache->nrows = this->_nrows;
+        cache->ncols = this->_ncols;
+        cache->halfBlocks = draw_half_blocks;
+        cache->valid = true;
+        dirty_top = 0;
+        dirty_bottom = this->_nrows;
+
+        // the panel covers the board, hold box, stats and combo text. Wipe whatever an older layout left in it.
+        panel->top = board_rows - STATS_LINES - 1 < 0 ? starty + board_rows - STATS_LINES - 1 : starty;
+        panel->bottom = starty + (board_rows > hold_rows ? board_rows : hold_rows);
+        panel->left = startx < winx - COMBO_TEXT_HALF ? startx : winx - COMBO_TEXT_HALF;
+        panel->right = statsx + STATS_WIDTH > holdx + hold_w ? statsx + STATS_WIDTH : holdx + hold_w;
+        if (panel->right < winx + COMBO_TEXT_HALF) panel->right = winx + COMBO_TEXT_HALF;
+        struct DrawRun wipe = {0};
+        for (int y = panel->top; y < panel->bottom; y++) {
+            if (y < 0 || y >= winy) continue;
+            for (int x = panel->left < 0 ? 0 : panel->left; x < panel->right && x < right; x++)
+                draw_run_put(&wipe, y, x, GAME_COLORS.DEFAULT, ' ');
+        }
+        draw_run_flush(&wipe);
+    }
+
+    // the ghost moves without touching the board, repaint where it was and where it is now
+    if (cache->ghostX != this->_hdropX || cache->ghostY != this->_hdropY
+        || cache->ghostRot != this->_currentRot || cache->ghostPiece != this->_currentPiece) {
+        minopos_t lo = cache->ghostY < this->_hdropY ? cache->ghostY : this->_hdropY;
+        minopos_t hi = (minopos_t)((cache->ghostY > this->_hdropY ? cache->ghostY : this->_hdropY) + STATE_DIM);
+        if (lo < dirty_top) dirty_top = lo;
+        if (hi > dirty_bottom) dirty_bottom = hi;
+        cache->ghostX = this->_hdropX;
+        cache->ghostY = this->_hdropY;
+        cache->ghostRot = this->_currentRot;
+        cache->ghostPiece = this->_currentPiece;
+    }
+    if (dirty_top < 0) dirty_top = 0;
+    if (dirty_bottom > this->_nrows) dirty_bottom = this->_nrows;
+
+    // changed cells next to each other in one color go out as one string
+    struct DrawRun run = {0};
+    if (draw_half_blocks) {
+        // rows 2n and 2n + 1 share a screen row, the top one in the foreground of ▀ and the bottom one behind it
+        for (int line = dirty_top / 2; line < (dirty_bottom + 1) / 2; line++) {
+            int y = starty + line;
+            if (y < 0 || y > winy - 3) continue;
+            minopos_t top_by = (minopos_t)(line * 2);
+            bool has_bottom = top_by + 1 < this->_nrows;
+            uint8_t* top_shown = &cache->shown[(size_t)top_by * (size_t)this->_ncols];
+            uint8_t* bottom_shown = top_shown + this->_ncols;
+            for (minopos_t bx = 0; bx < this->_ncols; bx++) {
+                int x = startx + bx;
+                if (x < left || x > right - 3) continue;
+                uint8_t top = M_board_glyph(this, top_by, bx);
+                uint8_t bottom = has_bottom ? M_board_glyph(this, (minopos_t)(top_by + 1), bx) : GLYPH_UNKNOWN;
+                if (top == top_shown[bx] && (!has_bottom || bottom == bottom_shown[bx])) continue;
+                top_shown[bx] = top;
+                if (has_bottom) bottom_shown[bx] = bottom;
+                M_run_put_half(&run, y, x, M_glyph_color(top), has_bottom ? M_glyph_color(bottom) : DRAW_BG_OF(GAME_COLORS.DEFAULT));
+            }
+        }
+    } else {
+        for (minopos_t by = dirty_top; by < dirty_bottom; by++) {
+            int y = starty + by;
+            if (y < 0 || y > winy - 3) continue;
+            uint8_t* shown_row = &cache->shown[(size_t)by * (size_t)this->_ncols];
+            for (minopos_t bx = 0; bx < this->_ncols; bx++) {
+                int x = startx / 2 + bx;
+                if (x * 2 < left || x > right / 2 - 3) continue;
+                uint8_t glyph = M_board_glyph(this, by, bx);
+                if (glyph == shown_row[bx]) continue;
+                shown_row[bx] = glyph;
+                M_run_put_sq(&run, y, x, M_glyph_pair(glyph), glyph == GLYPH_GHOST ? '#' : ' ');
+            }
+        }
+    }
+    draw_run_flush(&run);
+
+    bool force_stats = false;
+
+    // draw held piece. Shown in the current piece's rotation, so it changes with it.
+    if (!cache->holdValid || cache->heldPiece != this->_heldPiece || cache->heldRot != this->_currentRot) {
+        for (int line = 0; line < hold_rows; line++) {
+            for (int x = 0; x < STATE_DIM + 2; x++) {
+                if (!draw_half_blocks) {
+                    M_run_put_sq(&run, starty + line, holdx / 2 + x, M_hold_pair(this, line, x), ' ');
+                    continue;
+                }
+                uint16_t bottom = line * 2 + 1 < STATE_DIM + 2 ? DRAW_BG_OF(M_hold_pair(this, line * 2 + 1, x)) : DRAW_BG_OF(GAME_COLORS.DEFAULT);
+                M_run_put_half(&run, starty + line, holdx + x, DRAW_BG_OF(M_hold_pair(this, line * 2, x)), bottom);
+            }
+        }
+        draw_run_flush(&run);
+        GCOLOR(BG, draw_text_centered(holdx + hold_w / 2, starty, "HELD:"));
+        cache->holdValid = true;
+        cache->heldPiece = this->_heldPiece;
+        cache->heldRot = this->_currentRot;
+        // on short boards the stats overlap the box, put them back on top
+        force_stats = true;
+    }
+
+    char stats[STATS_LINES][64] = {{0}};
+    snprintf(stats[0], 63, "Level: %d", this->_level);
+    snprintf(stats[1], 63, "Current Lines Cleared: %ld", this->_linesCleared);
+    snprintf(stats[2], 63, "Current Total Score: %ld", this->_points);
+    snprintf(stats[3], 63, "Latest Score: %ld", this->_lastPoints);
+    snprintf(stats[4], 63, "Latest Combo: %s", combo_to_name(this->_lastCombo));
+    snprintf(stats[5], 63, "B2B Streak: %ld", this->_b2b);
+    static const int stats_rows[STATS_LINES] = {7, 5, 4, 3, 2, 1}; // counted up from the bottom of the board
+    for (int i = 0; i < STATS_LINES; i++) {
+        if (!force_stats && strcmp(stats[i], cache->stats[i]) == 0) continue;
+        // pad over the tail of a longer old string
+        int old_len = (int)strlen(cache->stats[i]);
+        GCOLOR(DEFAULT, draw_printw(starty + board_rows - stats_rows[i], statsx, "%-*s", old_len, stats[i]));
+        memcpy(cache->stats[i], stats[i], sizeof(stats[i]));
+    }
+
+    uint64_t anim_ms = M_combo_anim_ms(this);
+    if (anim_ms < COMBO_ANIM_MS) {
+        const char* combo_text = combo_to_name(this->_lastCombo);
+        int32_t combo_text_len = (int)strlen(combo_text);
+        if (this->_lastPoints < 800)
+            GCOLOR(DEFAULT, draw_text_centered(winx, starty + 3, combo_text))
+        else
+            GCOLOR(GOLDEN, draw_text_centered(winx, starty + 3, combo_text));
+
+        if (!draw_combo_shutter) {
+            // the text just appears and disappears
+        } else if (anim_ms < COMBO_ANIM_MS / 2) {
+            float t = (float)anim_ms / (float)(COMBO_ANIM_MS / 2);
+            for (int mask_x = -combo_text_len / 2; mask_x <= combo_text_len / 2; mask_x++) {
+                // shutter effect
+                if ((float)(mask_x + combo_text_len / 2) / (float)(combo_text_len) > t) {
+                    GCOLOR(SPAWN_ZONE, draw_addch(starty + 3, winx + mask_x, ' '))
+                }
+            }
+        } else if (anim_ms > 3 * COMBO_ANIM_MS / 4) {
+            float t = (float)(anim_ms - 3 * COMBO_ANIM_MS / 4) / (float)(COMBO_ANIM_MS / 4);
+            for (int mask_x = -combo_text_len / 2; mask_x <= combo_text_len / 2; mask_x++) {
+                // shutter effect
+                if ((float)(mask_x + combo_text_len / 2) / (float)(combo_text_len) < t) {
+                    GCOLOR(SPAWN_ZONE, draw_addch(starty + 3, winx + mask_x, ' '))
+                }
+            }
+        }
+        // the text covers screen row 3 of the board, which has to be repainted under it next frame
+        for (int by = 3 * rows_per_line; by < 4 * rows_per_line && by < this->_nrows; by++)
+            memset(&cache->shown[(size_t)by * (size_t)this->_ncols], GLYPH_UNKNOWN, (size_t)this->_ncols);
+        cache->comboShown = true;
+    } else if (cache->comboShown) {
+        // the text may also have covered the hold box and stats, repaint everything once it's gone
+        cache->valid = false;
+    }
+
+    if (too_short_flag) {
+        GCOLOR(GOLDEN, draw_text_centered(winx, 0, "^ Make window taller! ^"));
+        GCOLOR(GOLDEN, draw_text_centered(winx, winy - 1, "v Make window taller! v"));
+    }
+    if (too_narrow_flag) {
+        GCOLOR(GOLDEN, draw_text_centered(winx, winy / 2, "<- Make window wider! ->"));
+    }
+}
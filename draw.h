@@ -0,0 +1,254 @@
+#ifndef DRAW_H
+#define DRAW_H
+// Curses drawing of a game board, its hold box and stats. Shared by the game and the spectator viewer,
+// which draws a Matrix rebuilt from the broadcast instead of a simulated one.
+// Everything is drawn through the draw_* functions below, which go to curses or to the ANSI writer in ansiterm.h.
+
+#include <curses.h>
+
+#include "matrix.h"
+
+// DEFINES ----------------------------------------
+#define COLOR(x, stmt) {draw_color_on(x); \
+stmt; \
+draw_color_off(x);}
+
+#define C_CHAR(x) (x & 255) // strip extra info off of chtype
+
+// 0-255 0-1000
+#define C_RESCALE(x) ((short int)((float)x * 3.90625f))
+#define SOLID(r, g, b) r, g, b, r, g, b // duplicate pairs
+
+typedef uint8_t ColorPair_t;
+
+// palette colors are numbered the way set_rgb_pair numbers them, two per pair
+#define DRAW_FG_OF(pair) ((uint16_t)((pair) * 2))
+#define DRAW_BG_OF(pair) ((uint16_t)((pair) * 2 + 1))
+
+#define DRAW_UPPER_HALF '\x01' // drawn as ▀, the foreground on top and the background below
+
+// square-approximate version of the character printing functions
+#define mvaddch_sq(y, x, c) (mvaddch((y), (x) * 2, (c)), addch((c)))
+
+#define addch_sq(p1) (addch((p1)), addch((p1)))
+
+#define move_sq(y, x) (move((y), (x) * 2))
+
+// boards that can be on screen at once, each remembers what it drew separately
+#define DRAW_VIEWS 2
+// END DEFINES ---------------------------------------
+
+// STRUCTS -------------------------------------------
+// where drawing goes
+enum DrawBackend_t {
+    DRAW_CURSES, // curses works out the changes, colors are palette entries redefined with init_color
+    DRAW_ANSI // own cell buffers written with 24-bit colors, for terminals that can't redefine colors
+};
+extern enum DrawBackend_t draw_backend; // pick before init_palette
+
+// board and hold box as half-block cells, two board rows to a screen row. Curses then needs a UTF-8 locale.
+extern bool draw_half_blocks;
+struct ColorSet {
+    ColorPair_t DEFAULT, DEFAULT_INV, BG, SPAWN_ZONE, GHOST, GOLDEN, METEOR, METEOR2;
+    ColorPair_t I_PIECE, J_PIECE, L_PIECE, O_PIECE, T_PIECE, S_PIECE, Z_PIECE, GARBAGE_PIECE;
+};
+extern struct ColorSet GAME_COLORS;
+#define GCOLOR(x, stmt) COLOR(GAME_COLORS.x, (stmt)) // version that aliases colors stored within the global struct
+
+// a run of same-colored characters on one row, written with a single attribute change. Curses otherwise
+// sees an attron/attroff around every character, and terminals get an escape sequence for each switch.
+#define RUN_MAX 256
+struct DrawRun {
+    int y, x; // where the pending characters start
+    int len;
+    ColorPair_t pair;
+    char text[RUN_MAX];
+};
+
+// animate combo text in and out. Repaints a line every frame while it runs, frontends short on bandwidth turn it off.
+extern bool draw_combo_shutter;
+// END STRUCTS ---------------------------------------
+
+// FUNCTS --------------------------------------------
+
+/**
+ * Create a new `COLOR_PAIR` for ncurses
+ * @param fr Foreground red
+ * @param fb Foreground blue
+ * @param fg Foreground green
+ * @param br Background red
+ * @param bg Background green
+ * @param bb Background blue
+ * @warning Foreground color doesn't always appear accurate to input color. This is probably due to the terminal trying to create text contrast.
+ */
+uint8_t set_rgb_pair(uint8_t fr, uint8_t fb, uint8_t fg, uint8_t br, uint8_t bg, uint8_t bb);
+
+/**
+ * Parse a backend name from the command line.
+ * @param name "curses" or "ansi"
+ * @param out Set when the name is known.
+ * @returns `false` for any other name.
+ */
+bool draw_backend_parse(const char* name, enum DrawBackend_t* out);
+
+/**
+ * Take the character set from the environment, which curses needs to write ▀. Call before `initscr`.
+ * @returns `false` when half blocks are drawn through curses and the locale isn't UTF-8.
+ */
+bool draw_setup_locale();
+
+/**
+ * A color pair of two palette colors, made the first time it's asked for. Pairs made this way are forgotten, and
+ * the board repainted, if they would ever run out.
+ * @param fg Foreground, `DRAW_FG_OF` or `DRAW_BG_OF` of a pair from `set_rgb_pair`
+ * @param bg Background, the same
+ */
+ColorPair_t draw_pair_for(uint16_t fg, uint16_t bg);
+
+/**
+ * Sets every value within GAME_COLORS to pre-defined RGB
+ */
+void init_palette();
+
+/**
+ * Converts from tetromino type to its color.
+ * @param piece The type of piece
+ */
+ColorPair_t toPieceColor(enum TetrominoType_t piece);
+
+/**
+ * Draw what follows in a color pair, until `draw_color_off`. Use through `COLOR`/`GCOLOR`.
+ * @param pair Color pair
+ */
+void draw_color_on(ColorPair_t pair);
+
+/**
+ * Go back to the default colors.
+ * @param pair Color pair that was turned on
+ */
+void draw_color_off(ColorPair_t pair);
+
+/**
+ * Draw a string, like `mvaddstr`.
+ * @param y Screen row
+ * @param x Screen column of the first character
+ * @param str cstring to draw
+ */
+void draw_addstr(int y, int x, const char* str);
+
+/**
+ * Draw at most `n` characters of a string, like `mvaddnstr`.
+ * @param y Screen row
+ * @param x Screen column of the first character
+ * @param str Characters to draw
+ * @param n Most characters drawn
+ */
+void draw_addnstr(int y, int x, const char* str, int n);
+
+/**
+ * Draw one character, like `mvaddch`.
+ * @param y Screen row
+ * @param x Screen column
+ * @param c Character
+ */
+void draw_addch(int y, int x, char c);
+
+/**
+ * Draw formatted text, like `mvprintw`.
+ * @param y Screen row
+ * @param x Screen column of the first character
+ * @param fmt printf format
+ */
+void draw_printw(int y, int x, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * Blank the whole screen, like `erase`.
+ */
+void draw_erase();
+
+/**
+ * Put everything drawn since the last call on the terminal, like `refresh`.
+ */
+void draw_present();
+
+/**
+ * Draw strings centered at their halfway point rather than their start.
+ * @warning String input must be null-terminated, otherwise memory access will be violated.
+ * @param x_cent Which column you want the text to be centered around
+ * @param y_cent Which row the string should occupy
+ * @param a cstring to draw
+ */
+void draw_text_centered(int x_cent, int y_cent, const char* str);
+
+/**
+ * Whether a screen position is covered by the playfield panel. Background effects skip it so the panel only has to be redrawn where it changed.
+ * @param y Screen row
+ * @param x Screen column, in characters
+ */
+bool in_panel(int y, int x);
+
+/**
+ * Queue a character. Writes out the pending run first if this one doesn't continue it on the same row in the same color.
+ * @param run Pending run, zeroed before the first call.
+ * @param y Screen row
+ * @param x Screen column, in characters
+ * @param pair Color pair
+ * @param c Character
+ */
+void draw_run_put(struct DrawRun* run, int y, int x, ColorPair_t pair, char c);
+
+/**
+ * Write out whatever the run still holds. Call once everything was queued.
+ * @param run Pending run.
+ */
+void draw_run_flush(struct DrawRun* run);
+
+/**
+ * Stop reserving the playfield area, so the background can wash the board away.
+ */
+void draw_release_panel();
+
+/**
+ * Forget what the playfield looked like, so the next `matrix_draw` repaints all of it.
+ */
+void draw_invalidate();
+
+/**
+ * Free what the drawing code keeps between frames.
+ */
+void draw_free();
+
+/**
+ * Whether `matrix_draw` would change anything on screen.
+ * @param this The instance of the calling object.
+ */
+bool matrix_draw_needed(Matrix*);
+
+/**
+ * Draw the playfield at the center of the screen. (only replaces areas covered by playfield)
+ * Only cells, stats and the hold box that changed since the last call are redrawn.
+ * @param this The instance of the calling object.
+ */
+void matrix_draw(Matrix*);
+
+/**
+ * Whether `matrix_draw_view` would change anything on screen.
+ * @param this The instance of the calling object.
+ * @param view Which of the boards on screen, below DRAW_VIEWS.
+ * @param left First screen column of the view.
+ * @param width Screen columns of the view.
+ */
+bool matrix_draw_view_needed(Matrix*, int view, int left, int width);
+
+/**
+ * Draw the playfield centered in a part of the screen, for screens that show more than one board.
+ * `matrix_draw` is view 0 spanning the whole screen.
+ * @param this The instance of the calling object.
+ * @param view Which of the boards on screen, below DRAW_VIEWS. Each game keeps to its own view.
+ * @param left First screen column of the view.
+ * @param width Screen columns of the view.
+ */
+void matrix_draw_view(Matrix*, int view, int left, int width);
+// END FUNCS ----------------------------------------
+
+#endif
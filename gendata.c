@@ -0,0 +1,58 @@
+// Build step: parses rotations.dat and wallkicks.dat with the engine's own text parser and prints them as C
+// tables, so the game doesn't need the files, or its working directory, at runtime. Usage: gendata > gamedata.c
+#include "matrix.h"
+
+int main() {
+    parse_rotations_file();
+    parse_kicks_file();
+    build_piece_masks();
+
+    printf("// generated by gendata from rotations.dat and wallkicks.dat, don't edit\n");
+    printf("#include \"matrix.h\"\n\n");
+
+    printf("const struct TetrominoDef TDataBuiltin[TETCOUNT] = {\n");
+    for (int p = 0; p < TETCOUNT; p++) {
+        printf("    { // %c\n        {\n", ".IJLSZOT"[INDEX_TO_PIECE(p)]);
+        for (int r = 0; r < 4; r++) {
+            printf("            {{");
+            for (int y = 0; y < STATE_DIM; y++) {
+                printf("%s{", y > 0 ? ", " : "");
+                for (int x = 0; x < STATE_DIM; x++) {
+                    struct Mino* mino = &TData[p].rotations[r].state[y][x];
+                    printf("%s{%d, %u}", x > 0 ? ", " : "", mino->occupied, mino->type);
+                }
+                printf("}");
+            }
+            printf("}},\n");
+        }
+        printf("        },\n        {\n");
+        for (int from = 0; from < 4; from++) {
+            printf("            {");
+            for (int to = 0; to < 4; to++) {
+                int8_t (*offsets)[2] = TData[p].wallkicks[from][to].offsets;
+                printf("%s{{{%d, %d}, {%d, %d}, {%d, %d}, {%d, %d}}}", to > 0 ? ", " : "",
+                    offsets[0][0], offsets[0][1], offsets[1][0], offsets[1][1],
+                    offsets[2][0], offsets[2][1], offsets[3][0], offsets[3][1]);
+            }
+            printf("},\n");
+        }
+        printf("        }\n    },\n");
+    }
+    printf("};\n\n");
+
+    printf("const struct PieceMask TMaskBuiltin[TETCOUNT][4] = {\n");
+    for (int p = 0; p < TETCOUNT; p++) {
+        printf("    {");
+        for (int r = 0; r < 4; r++) {
+            struct PieceMask* pm = &TMask[p][r];
+            printf("%s{{%u, %u, %u, %u}, %u, %u, %u, %u, {%d, %d, %d, %d}, {", r > 0 ? ", " : "",
+                pm->rows[0], pm->rows[1], pm->rows[2], pm->rows[3], pm->top, pm->bottom, pm->left, pm->right,
+                pm->colBottom[0], pm->colBottom[1], pm->colBottom[2], pm->colBottom[3]);
+            for (int i = 0; i < PIECE_MINOS; i++) printf("%s{%d, %d}", i > 0 ? ", " : "", pm->cells[i].y, pm->cells[i].x);
+            printf("}}");
+        }
+        printf("},\n");
+    }
+    printf("};\n");
+    return 0;
+}
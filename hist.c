@@ -0,0 +1,73 @@
+#include "hist.h"
+
+#include <string.h>
+
+// values below HIST_SUB_BUCKETS get a bucket each, every octave above gets HIST_SUB_BUCKETS of them
+static inline size_t M_hist_index(uint64_t value) {
+    if (value < HIST_SUB_BUCKETS) return (size_t)value;
+    int octave = 63 - __builtin_clzll(value); // >= HIST_SUB_BITS
+    if (octave > HIST_MAX_BITS) return HIST_BUCKETS - 1;
+    size_t sub = (size_t)(value >> (octave - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1);
+    return (size_t)(octave - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS + sub;
+}
+
+// one past the largest value that lands in a bucket
+static uint64_t M_hist_bucket_end(size_t index) {
+    if (index < HIST_SUB_BUCKETS) return index + 1;
+    int octave = (int)(index / HIST_SUB_BUCKETS) + HIST_SUB_BITS - 1;
+    uint64_t sub = index % HIST_SUB_BUCKETS;
+    return (HIST_SUB_BUCKETS + sub + 1) << (octave - HIST_SUB_BITS);
+}
+
+void hist_reset(struct Histogram* h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void hist_record(struct Histogram* h, uint64_t value) {
+    h->buckets[M_hist_index(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+uint64_t hist_percentile(const struct Histogram* h, double q) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)h->count + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen < rank) continue;
+        if (i == HIST_BUCKETS - 1) return h->max;
+        uint64_t top = M_hist_bucket_end(i) - 1;
+        return top < h->max ? top : h->max;
+    }
+    return h->max;
+}
+
+void hist_merge(struct Histogram* dst, const struct Histogram* src) {
+    for (size_t i = 0; i < HIST_BUCKETS; i++) dst->buckets[i] += src->buckets[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+void hist_write(const struct Histogram* h, const char* name, FILE* f) {
+    fprintf(f, "%s: count %lu", name, h->count);
+    if (h->count > 0) {
+        fprintf(f, ", mean %.0f, min %lu, p50 %lu, p90 %lu, p99 %lu, p99.9 %lu, max %lu",
+            (double)h->sum / (double)h->count, h->min, hist_percentile(h, 0.5), hist_percentile(h, 0.9),
+            hist_percentile(h, 0.99), hist_percentile(h, 0.999), h->max);
+    }
+    fprintf(f, "\n");
+    // bucket lines are "from to count", so the file can be re-plotted without knowing the bucket layout
+    uint64_t from = 0;
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        uint64_t end = M_hist_bucket_end(i);
+        if (h->buckets[i] > 0) fprintf(f, "  %lu %lu %u\n", from, end - 1, h->buckets[i]);
+        from = end;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef HIST_H
+#define HIST_H
+// Fixed size latency histograms, in the style of HdrHistogram. Buckets double in width every octave and split
+// each octave into HIST_SUB_BUCKETS, so any value is kept to within 1/HIST_SUB_BUCKETS of itself.
+// Recording is a count leading zeros and an increment, cheap enough to run around every phase of every frame.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 40 // values from 2^41 up, about 36 minutes in ns, all land in the last bucket
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 2) * HIST_SUB_BUCKETS)
+
+struct Histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min, max; // exact, unlike the buckets
+    uint32_t buckets[HIST_BUCKETS];
+};
+
+/**
+ * Empty a histogram.
+ * @param h The histogram.
+ */
+void hist_reset(struct Histogram* h);
+
+/**
+ * Count one value.
+ * @param h The histogram.
+ * @param value Usually a duration in ns.
+ */
+void hist_record(struct Histogram* h, uint64_t value);
+
+/**
+ * Smallest value that at least a fraction of the recorded values are at or below.
+ * @param h The histogram.
+ * @param q Fraction, 0.5 for the median.
+ * @returns The top of the bucket holding that value, never more than the largest value recorded. 0 if empty.
+ */
+uint64_t hist_percentile(const struct Histogram* h, double q);
+
+/**
+ * Add the counts of one histogram to another.
+ * @param dst Updated.
+ * @param src Added.
+ */
+void hist_merge(struct Histogram* dst, const struct Histogram* src);
+
+/**
+ * Write a summary line and every non-empty bucket as text.
+ * @param h The histogram.
+ * @param name Printed at the start of the summary.
+ * @param f File to write to.
+ */
+void hist_write(const struct Histogram* h, const char* name, FILE* f);
+
+#endif
@@ -0,0 +1,96 @@
+#include "input.h"
+
+#include <string.h>
+
+void autorepeat_init(struct AutoRepeat* ar, uint32_t das_ms, uint32_t arr_ms) {
+    ar->dasMs = das_ms;
+    ar->arrMs = arr_ms;
+    ar->repeatMs = 0;
+    autorepeat_release_all(ar);
+}
+
+void autorepeat_release_all(struct AutoRepeat* ar) {
+    memset(ar->keys, 0, sizeof(ar->keys));
+}
+
+bool autorepeat_is_repeatable(enum Input_t input) {
+    return input == INPUT_LEFT || input == INPUT_RIGHT || input == INPUT_SOFT_DROP;
+}
+
+// smoothed, so one late repeat doesn't stretch it
+static void M_autorepeat_learn(struct AutoRepeat* ar, uint64_t gap) {
+    ar->repeatMs = ar->repeatMs == 0 ? (uint32_t)gap : (uint32_t)((3 * (uint64_t)ar->repeatMs + gap) / 4);
+}
+
+// how long a held key may go without a repeat. Three of the terminal's intervals once it's known.
+static uint64_t M_autorepeat_release_ms(const struct AutoRepeat* ar) {
+    if (ar->repeatMs == 0) return AUTOREPEAT_RELEASE_MS;
+    uint64_t ms = 3 * (uint64_t)ar->repeatMs;
+    if (ms < AUTOREPEAT_PACE_MS) return AUTOREPEAT_PACE_MS;
+    return ms < AUTOREPEAT_RELEASE_MS ? ms : AUTOREPEAT_RELEASE_MS;
+}
+
+bool autorepeat_press(struct AutoRepeat* ar, enum Input_t input, uint64_t now_ms) {
+    if (!autorepeat_is_repeatable(input)) return true;
+    struct HeldKey* key = &ar->keys[input];
+    uint64_t gap = now_ms - key->lastSeen;
+
+    if (key->down && key->repeating && gap <= M_autorepeat_release_ms(ar)) {
+        // the terminal's repeat, the DAS/ARR clock decides when to move
+        if (gap <= AUTOREPEAT_PACE_MS) M_autorepeat_learn(ar, gap);
+        key->lastSeen = now_ms;
+        return false;
+    }
+    if (key->down && !key->repeating) {
+        if (gap <= AUTOREPEAT_PACE_MS) {
+            // too quick for a tap, the terminal is repeating the key. `pressedAt` is the event before its first repeat,
+            // when this hold began, not the first of any taps before it.
+            M_autorepeat_learn(ar, gap);
+            key->repeating = true;
+            key->lastSeen = now_ms;
+            return false;
+        }
+        // another tap, or the terminal's first repeat after its delay. Move for it either way; if it was the repeat
+        // the key went down at the previous event.
+        key->pressedAt = key->lastSeen;
+        key->lastSeen = now_ms;
+        return true;
+    }
+
+    // the newest direction wins, like on a keyboard with key up events
+    if (input == INPUT_LEFT) ar->keys[INPUT_RIGHT].down = false;
+    if (input == INPUT_RIGHT) ar->keys[INPUT_LEFT].down = false;
+
+    key->down = true;
+    key->repeating = false;
+    key->charged = false;
+    key->pressedAt = now_ms;
+    key->lastSeen = now_ms;
+    return true;
+}
+
+uint32_t autorepeat_due(struct AutoRepeat* ar, enum Input_t input, uint64_t now_ms) {
+    struct HeldKey* key = &ar->keys[input];
+    if (!key->down) return 0;
+
+    if (!key->repeating) {
+        if (now_ms - key->lastSeen > AUTOREPEAT_CONFIRM_MS) key->down = false; // it was a tap
+        return 0;
+    }
+    if (now_ms - key->lastSeen > M_autorepeat_release_ms(ar)) {
+        key->down = false;
+        return 0;
+    }
+
+    if (!key->charged) {
+        if (now_ms - key->pressedAt < ar->dasMs) return 0;
+        key->charged = true;
+        key->nextRepeat = now_ms; // late if the terminal's repeat delay is longer than DAS, don't make up for it
+    }
+    if (ar->arrMs == 0) return AUTOREPEAT_INSTANT;
+    if (now_ms < key->nextRepeat) return 0;
+
+    uint32_t count = (uint32_t)((now_ms - key->nextRepeat) / ar->arrMs) + 1;
+    key->nextRepeat += (uint64_t)count * ar->arrMs;
+    return count;
+}
@@ -0,0 +1,75 @@
+#ifndef INPUT_H
+#define INPUT_H
+// Delayed Auto Shift / Auto Repeat Rate for the terminal frontend.
+// Terminals only send key presses and their own repeats, never releases, so a key counts as held while
+// its repeats keep arriving and as released once they stop for a few of the terminal's repeat intervals.
+
+#include "matrix.h"
+
+// longest gap between events of one key that can only be the terminal repeating it. Repeats arrive every 30-50 ms,
+// nobody taps a key that fast.
+#define AUTOREPEAT_PACE_MS 60
+// longest gap between terminal repeats of a held key, until the terminal's repeat interval has been seen
+#define AUTOREPEAT_RELEASE_MS 120
+// longest terminal repeat delay; a key that hasn't repeated by then was only tapped
+#define AUTOREPEAT_CONFIRM_MS 1000
+// `autorepeat_due` result when ARR is 0, the move should be repeated as far as it goes
+#define AUTOREPEAT_INSTANT UINT32_MAX
+
+struct HeldKey {
+    bool down;
+    bool repeating; // events arrive at repeat pace, so this is a hold and not taps
+    uint64_t pressedAt; // ms, the event before the latest slow gap: when the key went down if this turns out to be a hold
+    uint64_t lastSeen; // ms
+    uint64_t nextRepeat; // ms, only meaningful once DAS has charged
+    bool charged;
+};
+
+struct AutoRepeat {
+    uint32_t dasMs; // hold time before auto repeat starts
+    uint32_t arrMs; // time between auto repeated moves, 0 for instant
+    uint32_t repeatMs; // the terminal's repeat interval, learned from held keys. 0 until one was seen.
+    struct HeldKey keys[INPUT_COUNT]; // indexed by input, only left, right and soft drop repeat
+};
+
+/**
+ * Set the timings and release every key.
+ * @param ar The auto repeat state.
+ * @param das_ms Delayed Auto Shift, in ms.
+ * @param arr_ms Auto Repeat Rate, in ms between moves. 0 moves instantly.
+ */
+void autorepeat_init(struct AutoRepeat* ar, uint32_t das_ms, uint32_t arr_ms);
+
+/**
+ * Release every key, for example when a game ends.
+ * @param ar The auto repeat state.
+ */
+void autorepeat_release_all(struct AutoRepeat* ar);
+
+/**
+ * Whether an input auto repeats while held.
+ * @param input The action.
+ */
+bool autorepeat_is_repeatable(enum Input_t input);
+
+/**
+ * Feed a key event from the terminal.
+ * @param ar The auto repeat state.
+ * @param input Action the key maps to.
+ * @param now_ms Monotonic time of the event.
+ * @returns `true` if the input should be applied now. The first event within `AUTOREPEAT_PACE_MS` of the one before
+ *          makes the key held, timed from the event before the terminal's first repeat. That event and every later
+ *          repeat are swallowed, `autorepeat_due` takes over.
+ */
+bool autorepeat_press(struct AutoRepeat* ar, enum Input_t input, uint64_t now_ms);
+
+/**
+ * Advance a held key to the current time, releasing it once a few of the terminal's repeats in a row are missing.
+ * @param ar The auto repeat state.
+ * @param input A repeatable action.
+ * @param now_ms Monotonic time of the current tick.
+ * @returns How many times to apply the input now, `AUTOREPEAT_INSTANT` to apply it until it stops moving.
+ */
+uint32_t autorepeat_due(struct AutoRepeat* ar, enum Input_t input, uint64_t now_ms);
+
+#endif
@@ -0,0 +1,1200 @@
+#include "matrix.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <sys/fcntl.h>
+#include <unistd.h>
+
+void (*matrix_fail_hook)() = NULL;
+
+struct TetrominoDef TData[TETCOUNT] = {0};
+struct PieceMask TMask[TETCOUNT][4] = {0};
+
+// fall speed per level, in thousandths of G. Level n used to fall a row every 80 - 5n ticks of 16 ms.
+#define LEVEL_MAX 15
+static const uint32_t LEVEL_MILLI_G[LEVEL_MAX + 1] = {13, 14, 15, 16, 17, 19, 21, 23, 26, 30, 35, 42, 52, 69, 104, 208};
+
+const char* combo_to_name(enum ComboType_t combo) {
+    static const char* names[] = {
+        "None",
+        "Single",
+        "Double",
+        "Triple",
+        "- Tetris -",
+        "Mini T-Spin",
+        "T-Spin Single",
+        "- T-Spin Double -",
+        "-| T-Spin Triple |-",
+        "Back-To-Back",
+        "I-Spin",
+        "J-Spin",
+        "L-Spin",
+        "S-Spin",
+        "Z-Spin"
+    };
+    if ((int)combo < 0 || (size_t)combo >= ELMCOUNT(names)) return "Unknown";
+    return names[(int)combo];
+}
+
+enum TetrominoType_t toType(char tetromino_letter) {
+    switch (tetromino_letter) {
+        case 'I': case 'i': return I;
+        case 'J': case 'j': return J;
+        case 'L': case 'l': return L;
+        case 'O': case 'o': return O;
+        case 'T': case 't': return T;
+        case 'S': case 's': return S;
+        case 'Z': case 'z': return Z;
+        default: return INVALID;
+    }
+}
+
+// parsing defines
+#define CHUNKSIZE 256
+// same as accept, but doesn't test for character/newline
+#define SET_STATE(next_state) { \
+    state = next_state; \
+    break; }
+// ACCEPT is a soft accept, it will not break upon invalid entry.
+#define ACCEPT(to_accept, next_state) if (buf[c] == to_accept) { \
+    if (to_accept == '\n') ++lineno; \
+    state = next_state; \
+    break; }
+#define DECLINE_IF(expr, filename) if ((expr)) FAILF("matrix.c(%d): Unexpected character %c in %s(%ld)\n", __LINE__, buf[c], filename, lineno)
+#define DECLINE(filename) FAILF("matrix.c(%d): Unexpected character %c in %s(%ld)\n", __LINE__, buf[c], filename, lineno)
+#define SKIP_WHITESPACE() if (isspace(buf[c]) && buf[c] != '\n') break
+
+void parse_rotations_file() {
+    int rotFile = open("./rotations.dat", O_RDONLY);
+    if (rotFile < 0) FAIL("Could not load ./rotations.dat. Make sure executable is in the same folder as the source code.\n");
+
+    char buf[CHUNKSIZE] = {0};
+    ssize_t read_count = 0;
+    size_t lineno = 1;
+    enum TetrominoType_t currentPiece = INVALID;
+
+    // for reading in piece data
+    int curX = 0, curY = 0;
+    size_t rotCounter = 0;
+
+    int state = 0; // state machine for parsing
+    while ((read_count = read(rotFile, buf, CHUNKSIZE))) {
+        for (uint32_t c = 0; c < read_count; c++) {
+            switch (state) {
+                case 0: // expect ':'
+                    SKIP_WHITESPACE();
+                    ACCEPT('\n', 0); // newline = stay in state 0
+                    ACCEPT(':', 1);
+                    DECLINE("rotations.dat"); // fallthrough
+                break;
+                case 1: // expect a piece name
+                    SKIP_WHITESPACE();
+                    if (currentPiece != INVALID) {
+                        DECLINE_IF(buf[c] != '\n', "rotations.dat"); // accept only one
+                        ACCEPT('\n', 2);
+                    }
+                    currentPiece = toType(buf[c]);
+                    if (currentPiece == INVALID)
+                        FAILF("Unexpected piece type provided in rotations.dat(%ld): %c\n", lineno, buf[c]);
+                    // accept valid piece
+                break;
+                case 2: // parse piece data 
+                    SKIP_WHITESPACE();
+                    ACCEPT('$', 99);
+                    if (buf[c] == ':') {
+                        curX = 0;
+                        curY = 0;
+                        rotCounter = 0;
+                        currentPiece = INVALID;
+                        SET_STATE(1); // reset state if piece data done
+                    }
+                    if (buf[c] == '\n') {
+                        ++curY;
+                        curX = 0;
+                        DECLINE_IF(curY > STATE_DIM, "rotations.dat"); // out of range
+                        ACCEPT('\n', 2);
+                    }
+                    if (buf[c] == '>') {
+                        curY = -1; // workaround
+                        rotCounter++;
+                        SET_STATE(2);
+                    }
+                    DECLINE_IF(!(buf[c] == '0' || buf[c] == '1'), "rotation.dat");
+                    struct TetrominoState* currentRots = TData[PIECE_TO_INDEX(currentPiece)].rotations;
+                    if (buf[c] == '0') {
+                        currentRots[rotCounter].state[curY][curX].occupied = false;
+                        currentRots[rotCounter].state[curY][curX].type = INVALID;
+                        ++curX; // goes one past the last character, normally
+                        SET_STATE(2);
+                        DECLINE_IF(curX > STATE_DIM, "rotation.dat"); // out of range
+                    }
+                    if (buf[c] == '1') {
+                        currentRots[rotCounter].state[curY][curX].occupied = true;
+                        currentRots[rotCounter].state[curY][curX].type = (uint8_t)currentPiece;
+                        ++curX; // goes one past the last character normally
+                        SET_STATE(2);
+                        DECLINE_IF(curX > STATE_DIM, "rotation.dat"); // out of range
+                    }
+                break;
+                default: break;
+            }
+        }
+    }
+
+    close(rotFile);
+}
+
+void parse_kicks_file() {
+    int kckFile = open("./wallkicks.dat", O_RDONLY);
+    if (kckFile < 0) FAIL("Could not load ./wallkicks.dat. Make sure executable is in the same folder as the source code.\n");
+    
+    char buf[CHUNKSIZE] = {0};
+    ssize_t read_count = 0;
+    size_t lineno = 1;
+    enum TetrominoType_t currentPiece = INVALID;
+
+    int start_rot = -1, end_rot = -1;
+
+    int offset_row = 0;
+    int offset_col = 0; // for parsing pairs
+    int digits_read = 0; // for error checking
+    bool negate = false;
+
+    int state = 0; // state machine for parsing
+    while ((read_count = read(kckFile, buf, CHUNKSIZE))) {
+        for (uint32_t c = 0; c < read_count; c++) {
+            switch (state) {
+                case 0: // expect ':'
+                    SKIP_WHITESPACE();
+                    ACCEPT('\n', 0); // newline = stay in state 0
+                    ACCEPT(':', 1);
+                    DECLINE("wallkicks.dat"); // fallthrough
+                break;
+                case 1: // expect a piece name
+                    SKIP_WHITESPACE();
+                    if (currentPiece != INVALID) {
+                        DECLINE_IF(buf[c] != '\n', "wallkicks.dat"); // accept only one
+                        ACCEPT('\n', 2);
+                    }
+                    currentPiece = toType(buf[c]);
+                    if (currentPiece == INVALID)
+                        FAILF("Unexpected piece type provided in wallkicks.dat(%ld): %c\n", lineno, buf[c])
+                    // accept valid piece
+                break;
+                case 2: // expect #
+                    ACCEPT('#', 3);
+                    DECLINE("wallkicks.dat");
+                break;
+                case 3: // parse starting rotation state
+                    if (isdigit(buf[c])) {
+                        start_rot = buf[c] - '0';
+                        SET_STATE(4);
+                    }
+                    DECLINE("wallkicks.dat");
+                break;
+                case 4: // parse ending rotation state
+                    if (isdigit(buf[c])) {
+                        end_rot = buf[c] - '0';
+                        SET_STATE(5);
+                    }
+                    DECLINE("wallkicks.dat");
+                break;
+                case 5: // expect newline after state definition
+                    SKIP_WHITESPACE();
+                    ACCEPT('\n', 6);
+                break;
+                case 6: // parse offset pairs
+                    SKIP_WHITESPACE();
+                    if (buf[c] == '#' || buf[c] == ':') {
+                        offset_row = 0;
+                        offset_col = 0;
+                        negate = false;
+                        start_rot = -1;
+                        end_rot = -1;
+                    }
+                    ACCEPT('$', 99);
+                    ACCEPT('#', 3);
+                    if (buf[c] == ':') currentPiece = INVALID;
+                    ACCEPT(':', 1);
+                    if (buf[c] == '\n') {
+                        ++offset_row;
+                        offset_col = 0;
+                        digits_read = 0;
+                        DECLINE_IF(offset_row > 4, "wallkicks.dat");
+                        ACCEPT('\n', 6);
+                    }
+                    if (buf[c] == '-') {
+                        negate = true;
+                        SET_STATE(6); // stay in state
+                    }
+                    if (buf[c] == ',') {
+                        negate = false; // reset
+                        ++offset_col;
+                        DECLINE_IF(offset_col > 1, "wallkicks.dat");
+                        SET_STATE(6);
+                    }
+                    if (isdigit(buf[c]) && digits_read < 2) { // accept digit
+                        // long line, but sets the wall kick data of the current piece in TData based on the parse file
+                        TData[PIECE_TO_INDEX(currentPiece)].wallkicks[start_rot][end_rot].offsets[offset_row][offset_col] = (int8_t)((negate? -1 : 1) * (buf[c] - '0'));
+                        ++digits_read;
+                        SET_STATE(6); // stay in state
+                    }
+                    DECLINE("wallkicks.dat");
+                break;
+                default: break;
+            }
+        }
+    }
+    
+    close(kckFile);
+}
+
+void parse_game_data() {
+#ifdef MATRIX_TEXT_DATA
+    parse_rotations_file();
+    parse_kicks_file();
+    build_piece_masks();
+#else
+    memcpy(TData, TDataBuiltin, sizeof(TData));
+    memcpy(TMask, TMaskBuiltin, sizeof(TMask));
+#endif
+}
+
+void build_piece_masks() {
+    for (int p = 0; p < TETCOUNT; p++) {
+        for (int r = 0; r < 4; r++) {
+            struct PieceMask* pm = &TMask[p][r];
+            struct TetrominoState* st = &TData[p].rotations[r];
+            pm->top = STATE_DIM;
+            pm->bottom = 0;
+            pm->left = STATE_DIM;
+            pm->right = 0;
+            int count = 0;
+            for (uint8_t y = 0; y < STATE_DIM; y++) {
+                pm->rows[y] = 0;
+                for (uint8_t x = 0; x < STATE_DIM; x++) {
+                    if (!st->state[y][x].occupied) continue;
+                    if (count < PIECE_MINOS) {
+                        pm->cells[count].y = (int8_t)y;
+                        pm->cells[count].x = (int8_t)x;
+                    }
+                    count++;
+                    pm->rows[y] |= (uint8_t)(1u << x);
+                    if (x < pm->left) pm->left = x;
+                    if (x + 1 > pm->right) pm->right = (uint8_t)(x + 1);
+                }
+                if (pm->rows[y] == 0) continue;
+                if (y < pm->top) pm->top = y;
+                pm->bottom = (uint8_t)(y + 1);
+            }
+            if (count != PIECE_MINOS) FAILF("rotations.dat: every rotation needs %d minos, one has %d.\n", PIECE_MINOS, count);
+            for (int x = 0; x < STATE_DIM; x++) {
+                pm->colBottom[x] = -1;
+                for (int8_t y = 0; y < STATE_DIM; y++) {
+                    if (pm->rows[y] & (1u << x)) pm->colBottom[x] = y;
+                }
+            }
+        }
+    }
+}
+
+Matrix* matrix_construct() {
+    return matrix_construct_rs(24, 10); // these could be #defines, but I feel like making it adjustable
+}
+
+Matrix* matrix_construct_rs(minopos_t p_nrows, minopos_t p_ncols) {
+    Matrix* ret = (Matrix*)calloc(1, sizeof(Matrix));
+    if (ret == NULL) FAIL("Out of memory allocating a game.\n");
+    ret->_board = NULL;
+    ret->_bits = NULL;
+    ret->_storage = NULL;
+    ret->_storageSize = 0;
+    matrix_seed(ret, 0);
+    matrix_reset(ret, p_nrows, p_ncols);
+    return ret;
+}
+
+void matrix_reset(Matrix* this, minopos_t p_nrows, minopos_t p_ncols) {
+    matrix_make_board_rs(this, p_nrows, p_ncols);
+
+    // centered, 3 on a standard 10 wide board
+    this->_rootX = (minopos_t)(this->_ncols / 2 - STATE_DIM / 2);
+    this->_rootY = 3;
+
+    this->_tetX = this->_rootX;
+    this->_tetY = this->_rootY;
+
+    this->_heldPiece = INVALID;
+    this->_currentPiece = INVALID;
+    this->_currentPieceData = NULL;
+
+    this->_currentRot = 0;
+
+    this->_holdAllowable = true;
+    this->_pieceStopped = false;
+
+    this->_hdropX = 0;
+    this->_hdropY = 0;
+    this->_hdropQueued = false;
+
+    this->_fallProgress = 0;
+    this->_lockCounter = 0;
+    this->_level = 0;
+    matrix_set_speed(this, LEVEL_MILLI_G[0], MATRIX_LOCK_DELAY_MS);
+    this->_linesCleared = 0;
+    this->_points = 0;
+    this->_lastPoints = 0;
+    this->_b2b = 0;
+    this->_lastCombo = NOTHING;
+    this->_lastScoringPiece = INVALID;
+
+    this->_comboAnimTimer = 9999;
+    memset(this->_comboCounts, 0, sizeof(this->_comboCounts));
+    this->_locks = 0;
+
+    // keeps the generator going, but deals from a fresh bag
+    this->_queueHead = 0;
+    this->_queueLen = 0;
+}
+
+bool matrix_new_game(Matrix* this, minopos_t p_nrows, minopos_t p_ncols, uint64_t seed) {
+    matrix_reset(this, p_nrows, p_ncols);
+    matrix_seed(this, seed);
+    return matrix_respawn_tet_random(this);
+}
+
+void M_matrix_destroy_board(Matrix* this) {
+    free(this->_storage);
+    this->_storage = NULL;
+    this->_storageSize = 0;
+    this->_board = NULL;
+    this->_bits = NULL;
+    this->_colTop = NULL;
+    this->_colHole = NULL;
+}
+
+// points the board arrays into `_storage`, growing it if the current size needs more. Returns the bytes in use.
+static size_t M_matrix_layout_board(Matrix* this) {
+    this->_bbStride = BB_ROW_WORDS(this->_ncols);
+    size_t bits_size = ALIGN_UP((size_t)this->_nrows * this->_bbStride * sizeof(bbword_t), MATRIX_ALIGN);
+    size_t cells_size = ALIGN_UP((size_t)this->_nrows * (size_t)this->_ncols * sizeof(struct Mino), MATRIX_ALIGN);
+    size_t skyline_size = ALIGN_UP(2 * (size_t)this->_ncols * sizeof(minopos_t), MATRIX_ALIGN);
+
+    if (bits_size + cells_size + skyline_size > this->_storageSize) {
+        M_matrix_destroy_board(this);
+        this->_storage = aligned_alloc(MATRIX_ALIGN, bits_size + cells_size + skyline_size);
+        if (this->_storage == NULL) FAIL("Out of memory allocating the board.\n");
+        this->_storageSize = bits_size + cells_size + skyline_size;
+    }
+    // bits go first, they are what collision tests touch
+    this->_bits = (bbword_t*)this->_storage;
+    this->_board = (struct Mino*)((char*)this->_storage + bits_size);
+    this->_colTop = (minopos_t*)((char*)this->_storage + bits_size + cells_size);
+    this->_colHole = this->_colTop + this->_ncols;
+    return bits_size + cells_size + skyline_size;
+}
+
+void M_matrix_make_board(Matrix* this) {
+    M_matrix_layout_board(this);
+
+    memset(this->_board, 0, (size_t)this->_nrows * (size_t)this->_ncols * sizeof(struct Mino));
+    M_matrix_clear_bits(this, 0, this->_nrows);
+    for (minopos_t x = 0; x < this->_ncols; x++) {
+        this->_colTop[x] = this->_nrows;
+        this->_colHole[x] = -1;
+    }
+    this->_piecePasted = false;
+    this->_hdropDirty = true;
+    this->_damageTop = 0;
+    this->_damageBottom = this->_nrows;
+}
+// resize overload 
+void matrix_make_board_rs(Matrix* this, minopos_t p_nrows, minopos_t p_ncols) {
+    if (p_ncols < 1 || p_nrows < 1) FAIL("Invalid board size, negative or zero.\n");
+    this->_nrows = p_nrows;
+    this->_ncols = p_ncols;
+    M_matrix_make_board(this);
+}
+
+void matrix_copy(Matrix* dst, Matrix* src) {
+    void* storage = dst->_storage;
+    size_t storage_size = dst->_storageSize;
+    *dst = *src;
+    dst->_storage = storage;
+    dst->_storageSize = storage_size;
+
+    // same dimensions give the same layout, so the whole board is one copy
+    size_t used = M_matrix_layout_board(dst);
+    memcpy(dst->_storage, src->_storage, used);
+    dst->_damageTop = 0;
+    dst->_damageBottom = dst->_nrows;
+}
+
+// marks rows [top, bottom) as needing a redraw
+static inline void M_matrix_damage_rows(Matrix* this, minopos_t top, minopos_t bottom) {
+    if (top < this->_damageTop) this->_damageTop = top;
+    if (bottom > this->_damageBottom) this->_damageBottom = bottom;
+}
+
+// bitboard helpers ---
+static inline bbword_t* M_matrix_bb_row(Matrix* this, minopos_t y) {
+    return &this->_bits[(size_t)y * this->_bbStride];
+}
+
+// reads STATE_DIM bits of row y, starting at bit p
+static inline unsigned M_matrix_bb_window(Matrix* this, minopos_t y, unsigned p) {
+    bbword_t* row = M_matrix_bb_row(this, y);
+    if (this->_bbStride == 1) return (unsigned)(row[0] >> p) & ((1u << STATE_DIM) - 1);
+
+    // wide board, window may straddle two words
+    size_t w = p / BB_WORD_BITS;
+    unsigned sh = p % BB_WORD_BITS;
+    bbword_t v = row[w] >> sh;
+    if (sh > BB_WORD_BITS - STATE_DIM) v |= row[w + 1] << (BB_WORD_BITS - sh);
+    return (unsigned)v & ((1u << STATE_DIM) - 1);
+}
+
+// sets (or clears) the bits of `mask` in row y, starting at bit p
+static inline void M_matrix_bb_write(Matrix* this, minopos_t y, unsigned p, unsigned mask, bool set) {
+    bbword_t* row = M_matrix_bb_row(this, y);
+    size_t w = p / BB_WORD_BITS;
+    unsigned sh = p % BB_WORD_BITS;
+    bbword_t lo = (bbword_t)mask << sh;
+    bbword_t hi = (sh > BB_WORD_BITS - STATE_DIM) ? (bbword_t)mask >> (BB_WORD_BITS - sh) : 0;
+    if (set) {
+        row[w] |= lo;
+        if (hi) row[w + 1] |= hi;
+    } else {
+        row[w] &= ~lo;
+        if (hi) row[w + 1] &= ~hi;
+    }
+}
+
+static inline bool M_matrix_bb_row_full(Matrix* this, minopos_t y) {
+    bbword_t* row = M_matrix_bb_row(this, y);
+    for (size_t w = 0; w < this->_bbStride; w++) {
+        if (row[w] != ~(bbword_t)0) return false;
+    }
+    return true;
+}
+
+void M_matrix_clear_bits(Matrix* this, minopos_t first_row, minopos_t end_row) {
+    for (minopos_t y = first_row; y < end_row; y++) {
+        bbword_t* row = M_matrix_bb_row(this, y);
+        for (size_t w = 0; w < this->_bbStride; w++) row[w] = ~(bbword_t)0;
+        for (unsigned x = BB_GUARD; x < (unsigned)this->_ncols + BB_GUARD; x++) {
+            row[x / BB_WORD_BITS] &= ~((bbword_t)1 << (x % BB_WORD_BITS));
+        }
+    }
+}
+
+void matrix_set_cell(Matrix* this, minopos_t y, minopos_t x, enum TetrominoType_t type) {
+    if (y < 0 || y >= this->_nrows || x < 0 || x >= this->_ncols) return;
+    MATRIX_AT(this, y, x).occupied = type != INVALID;
+    MATRIX_AT(this, y, x).type = (uint8_t)type;
+    M_matrix_bb_write(this, y, (unsigned)(x + BB_GUARD), 1, type != INVALID);
+    M_matrix_damage_rows(this, y, (minopos_t)(y + 1));
+    M_matrix_scan_skyline(this, x, (minopos_t)(x + 1));
+    this->_hdropDirty = true;
+}
+
+// whether a cell is filled by something other than the unlocked piece
+static inline bool M_matrix_locked_at(Matrix* this, minopos_t y, minopos_t x) {
+    if (!MATRIX_AT(this, y, x).occupied) return false;
+    if (!this->_piecePasted) return true;
+    int r = y - this->_tetY;
+    int c = x - this->_tetX;
+    if (r < 0 || r >= STATE_DIM || c < 0 || c >= STATE_DIM) return true;
+    return !(TMask[PIECE_TO_INDEX(this->_currentPiece)][this->_currentRot].rows[r] & (1u << c));
+}
+
+void M_matrix_scan_skyline(Matrix* this, minopos_t first_col, minopos_t end_col) {
+    for (minopos_t x = first_col; x < end_col; x++) {
+        minopos_t top = 0;
+        while (top < this->_nrows && !M_matrix_locked_at(this, top, x)) top++;
+        minopos_t hole = (minopos_t)(this->_nrows - 1);
+        while (hole > top && M_matrix_locked_at(this, hole, x)) hole--;
+        this->_colTop[x] = top;
+        this->_colHole[x] = hole > top ? hole : -1;
+    }
+}
+
+// returns true or false depending on whether or not the current tetromino can fit where it is
+bool M_matrix_test_tet(Matrix* this) {
+    // every cell is out of bounds past these, and the shift below can't go negative
+    if (this->_tetX < -BB_GUARD || this->_tetX >= this->_ncols) return false;
+
+    struct PieceMask* pm = &TMask[PIECE_TO_INDEX(this->_currentPiece)][this->_currentRot];
+    unsigned p = (unsigned)(this->_tetX + BB_GUARD);
+    for (uint8_t r = pm->top; r < pm->bottom; r++) {
+        minopos_t y = (minopos_t)(this->_tetY + r);
+        if (y < 0 || y >= this->_nrows) return false; // piece failed to paste due to OOB
+        if (M_matrix_bb_window(this, y, p) & pm->rows[r]) return false; // occupied position or wall
+    }
+    return true;
+}
+
+bool M_matrix_test_tet_cells(Matrix* this) {
+    // straight from the parsed rotation grid, so it checks TMask rather than sharing its mistakes
+    const struct TetrominoState* st = &TData[PIECE_TO_INDEX(this->_currentPiece)].rotations[this->_currentRot];
+    for (int r = 0; r < STATE_DIM; r++) {
+        for (int c = 0; c < STATE_DIM; c++) {
+            if (!st->state[r][c].occupied) continue;
+            int y = this->_tetY + r;
+            int x = this->_tetX + c;
+            if (y < 0 || y >= this->_nrows || x < 0 || x >= this->_ncols) return false; // piece failed to paste due to OOB
+            if (MATRIX_AT(this, y, x).occupied) return false; // piece failed due to occupied position
+        }
+    }
+    return true;
+}
+
+bool M_matrix_paste_tet(Matrix* this) {
+    if (this->_currentPiece == INVALID) FAIL("Invalid game action! Attempted to paste an empty piece.\n");
+
+    if (!M_matrix_test_tet(this)) return false;
+
+    // the test passed, so every occupied cell is in bounds
+    struct PieceMask* pm = &TMask[PIECE_TO_INDEX(this->_currentPiece)][this->_currentRot];
+    unsigned p = (unsigned)(this->_tetX + BB_GUARD);
+    for (uint8_t r = pm->top; r < pm->bottom; r++)
+        M_matrix_bb_write(this, (minopos_t)(this->_tetY + r), p, pm->rows[r], true);
+    struct Mino mino = {true, (uint8_t)this->_currentPiece};
+    for (int i = 0; i < PIECE_MINOS; i++)
+        MATRIX_AT(this, this->_tetY + pm->cells[i].y, this->_tetX + pm->cells[i].x) = mino; // no checks failed, add to board
+    this->_piecePasted = true;
+    M_matrix_damage_rows(this, (minopos_t)(this->_tetY + pm->top), (minopos_t)(this->_tetY + pm->bottom));
+
+    return true;
+}
+
+void M_matrix_unpaste_tet(Matrix* this) {
+    if (this->_currentPiece == INVALID) FAIL("Invalid game action! Attempted to unpaste an empty piece.\n");
+    this->_piecePasted = false;
+
+    struct PieceMask* pm = &TMask[PIECE_TO_INDEX(this->_currentPiece)][this->_currentRot];
+    // columns of the piece that are on the board, a piece that failed to paste may hang over the edge
+    unsigned on_board = 0;
+    for (int c = pm->left; c < pm->right; c++) {
+        int x = this->_tetX + c;
+        if (x >= 0 && x < this->_ncols) on_board |= 1u << c;
+    }
+    struct Mino empty = {false, INVALID};
+    for (int i = 0; i < PIECE_MINOS; i++) {
+        int y = this->_tetY + pm->cells[i].y;
+        if (y < 0 || y >= this->_nrows || !(on_board & (1u << pm->cells[i].x))) continue;
+        MATRIX_AT(this, y, this->_tetX + pm->cells[i].x) = empty; // remove mino
+    }
+    for (uint8_t r = pm->top; r < pm->bottom; r++) {
+        minopos_t y = (minopos_t)(this->_tetY + r);
+        if (y < 0 || y >= this->_nrows) continue;
+
+        unsigned row_mask = pm->rows[r] & on_board;
+        if (this->_tetX >= -BB_GUARD)
+            M_matrix_bb_write(this, y, (unsigned)(this->_tetX + BB_GUARD), row_mask, false);
+        if (row_mask) M_matrix_damage_rows(this, y, (minopos_t)(y + 1));
+    }
+}
+
+void M_matrix_set_hdrop_pos(Matrix* this) {
+    this->_hdropDirty = false;
+    this->_hdropX = this->_tetX;
+
+    // above the skyline in every column it covers, the piece falls straight onto it. O(piece width).
+    struct PieceMask* pm = &TMask[PIECE_TO_INDEX(this->_currentPiece)][this->_currentRot];
+    minopos_t fall = this->_nrows;
+    for (int c = 0; c < STATE_DIM && fall >= 0; c++) {
+        if (pm->colBottom[c] < 0) continue;
+        minopos_t x = (minopos_t)(this->_tetX + c);
+        if (x < 0 || x >= this->_ncols) { fall = -1; break; }
+        minopos_t gap = (minopos_t)(this->_colTop[x] - 1 - (this->_tetY + pm->colBottom[c]));
+        if (gap < fall) fall = gap;
+    }
+    if (fall >= 0) {
+        this->_hdropY = (minopos_t)(this->_tetY + fall);
+        return;
+    }
+
+    // tucked under an overhang, step down
+    M_matrix_unpaste_tet(this);
+    minopos_t start_y = this->_tetY;
+
+    minopos_t max_itr = this->_nrows;
+    for (minopos_t i = 0; i < max_itr; i++) {
+        this->_tetY++;
+        if (!M_matrix_test_tet(this))
+            break;
+    }
+    this->_hdropY = this->_tetY - 1;
+
+    this->_tetY = start_y;
+    M_matrix_paste_tet(this);
+}
+
+bool M_matrix_test_if_stuck(Matrix* this) {
+    M_matrix_unpaste_tet(this);
+    bool flag = false;
+    this->_tetX += 1; // check right
+    flag = flag || M_matrix_test_tet(this);
+    this->_tetX -= 2; // check left
+    flag = flag || M_matrix_test_tet(this);
+    this->_tetX += 1; // check top
+    this->_tetY -= 1;
+    flag = flag || M_matrix_test_tet(this);
+    this->_tetY += 2; // check bottom
+    flag = flag || M_matrix_test_tet(this);
+    this->_tetY -= 1;
+    M_matrix_paste_tet(this);
+    return !flag;
+}
+
+enum ComboType_t M_matrix_check_combo_type(Matrix* this, bool is_stuck, uint16_t lines_cleared, enum TetrominoType_t locked_piece) {
+    if (is_stuck) {
+        switch (locked_piece) { // O should never be able to be locked
+            case T:
+                switch (lines_cleared) {
+                    case 0: return MINI_T_SPIN;
+                    case 1: return T_SPIN_SINGLE;
+                    case 2: return T_SPIN_DOUBLE;
+                    case 3: return T_SPIN_TRIPLE;
+                    default: return NOTHING;
+                }
+            break;
+            case I: return I_SPIN;
+            case J: return J_SPIN;
+            case L: return L_SPIN;
+            case S: return S_SPIN;
+            case Z: return Z_SPIN;
+            default: return NOTHING;
+        }
+    } else {
+        switch (locked_piece) {
+            case I: case J: case L: case S: case Z: case O: case T:
+            switch (lines_cleared) {
+                case 0: return NOTHING;
+                case 1: return SINGLE;
+                case 2: return DOUBLE;
+                case 3: return TRIPLE;
+                case 4: 
+                    if (this->_lastCombo == TETRIS || this->_lastCombo == B2B)
+                        return B2B;
+                    else
+                        return TETRIS;
+                default: return NOTHING;
+            }
+            default: return NOTHING;
+        }
+    }
+
+}
+
+size_t M_matrix_add_score(Matrix* this, enum ComboType_t current_combo) {
+    size_t score_to_add = 0;
+    switch (current_combo) {
+        case NOTHING: score_to_add = 0; break;
+        case SINGLE: score_to_add = 100; break;
+        case DOUBLE: score_to_add = 300; break;
+        case TRIPLE: score_to_add = 500; break;
+        case TETRIS: score_to_add = 800; break;
+        case MINI_T_SPIN: score_to_add = 100; break;
+        case T_SPIN_SINGLE: score_to_add = 800; break;
+        case T_SPIN_DOUBLE: score_to_add = 1200;
+            if (this->_lastCombo == B2B || this->_lastCombo == T_SPIN_DOUBLE || this->_lastCombo == T_SPIN_TRIPLE)
+                score_to_add += 600; // bonus for chaining hard moves
+        break;
+        case T_SPIN_TRIPLE: 
+            score_to_add = 1600;
+            if (this->_lastCombo == B2B || this->_lastCombo == T_SPIN_DOUBLE || this->_lastCombo == T_SPIN_TRIPLE)
+                score_to_add += 800; // bonus for chaining hard moves
+        break;
+        case B2B: 
+            switch (this->_lastScoringPiece) {
+                case I:
+                    score_to_add = 1200;
+                break;
+                case T:
+                    score_to_add = 1800;
+                break;
+                default: score_to_add = 0;
+            }
+        break;
+        // some fun ones
+        case I_SPIN: score_to_add = 300; break;
+        case J_SPIN: score_to_add = 300; break;
+        case L_SPIN: score_to_add = 300; break;
+        case S_SPIN: score_to_add = 300; break;
+        case Z_SPIN: score_to_add = 300; break;
+    }
+
+    if (current_combo == B2B || current_combo == T_SPIN_DOUBLE || current_combo == T_SPIN_TRIPLE || current_combo == TETRIS) {
+        this->_b2b++;
+    } else {
+        this->_b2b = 0;
+    }
+    this->_points += score_to_add;
+    return score_to_add;
+}
+void matrix_set_current_piece(Matrix* this, enum TetrominoType_t kind, uint8_t rot_index) {
+    this->_currentPiece = kind;
+    this->_currentRot = rot_index % 4;
+    this->_currentPieceData = &TData[PIECE_TO_INDEX(kind)];
+    this->_hdropDirty = true;
+}
+
+void matrix_hdrop(Matrix* this) {
+    this->_hdropQueued = true;
+}
+
+bool M_matrix_hdrop(Matrix* this) {
+    if (!this->_hdropQueued) return true;
+    this->_hdropQueued = false;
+    M_matrix_unpaste_tet(this);
+    this->_points += (size_t)(this->_hdropY - this->_tetY);
+    this->_tetX = this->_hdropX;
+    this->_tetY = this->_hdropY;
+    M_matrix_paste_tet(this);
+    return M_matrix_lock(this);
+}
+// 7bag tetris
+void matrix_seed(Matrix* this, uint64_t seed) {
+    this->_seed = seed;
+    rng_seed(&this->_rng, seed);
+    this->_queueHead = 0;
+    this->_queueLen = 0;
+}
+
+// appends one Fisher-Yates shuffled bag to the queue
+static void M_matrix_refill_bag(Matrix* this) {
+    uint8_t bag[TETCOUNT];
+    for (uint8_t i = 0; i < TETCOUNT; i++) bag[i] = (uint8_t)INDEX_TO_PIECE(i);
+    for (uint32_t i = TETCOUNT - 1; i > 0; i--) {
+        uint32_t j = rng_below(&this->_rng, i + 1);
+        uint8_t tmp = bag[i];
+        bag[i] = bag[j];
+        bag[j] = tmp;
+    }
+    for (uint8_t i = 0; i < TETCOUNT; i++) {
+        this->_queue[(this->_queueHead + this->_queueLen) % QUEUE_CAP] = bag[i];
+        this->_queueLen++;
+    }
+}
+
+enum TetrominoType_t matrix_peek_piece(Matrix* this, uint8_t n) {
+    if (this->_queueLen <= n) M_matrix_refill_bag(this);
+    return (enum TetrominoType_t)this->_queue[(this->_queueHead + n) % QUEUE_CAP];
+}
+
+enum TetrominoType_t M_matrix_bag_pick(Matrix* this) {
+    // keep a full bag visible behind the piece being taken
+    if (this->_queueLen <= TETCOUNT) M_matrix_refill_bag(this);
+    enum TetrominoType_t chosen = (enum TetrominoType_t)this->_queue[this->_queueHead];
+    this->_queueHead = (uint8_t)((this->_queueHead + 1) % QUEUE_CAP);
+    this->_queueLen--;
+    return chosen;
+}
+
+bool matrix_respawn_tet_random(Matrix* this) {
+    matrix_set_current_piece(this, M_matrix_bag_pick(this), 0);
+    this->_tetX = this->_rootX;
+    this->_tetY = this->_rootY;
+    this->_lockCounter = 0;
+    this->_fallProgress = 0;
+    this->_holdAllowable = true;
+    this->_hdropDirty = true;
+
+    return M_matrix_paste_tet(this);
+}
+
+bool matrix_respawn_tet(Matrix* this) {
+    this->_tetX = this->_rootX;
+    this->_tetY = this->_rootY;
+    this->_lockCounter = 0;
+    this->_fallProgress = 0;
+    this->_holdAllowable = true;
+    this->_hdropDirty = true;
+
+    return M_matrix_paste_tet(this);
+}
+
+// assume tet is already unpasted, to handle all pasting
+bool M_matrix_wallkick(Matrix* this, uint8_t start_rot, uint8_t end_rot) {
+    int startX = (int)this->_tetX;
+    int startY = (int)this->_tetY;
+
+    // retrieve kick data for current inital-final rotation states
+    struct WallkickDef* kickSubject = &this->_currentPieceData->wallkicks[start_rot][end_rot];
+
+    // go through each offset one by one, checking each xy pair
+    for (uint8_t kick_index = 0; kick_index < 4; kick_index++) {
+        int offX = startX + kickSubject->offsets[kick_index][0];
+        int offY = startY - kickSubject->offsets[kick_index][1];
+        this->_tetX = (minopos_t)offX;
+        this->_tetY = (minopos_t)offY;
+        if (M_matrix_paste_tet(this)) return true;
+    }
+    this->_tetX = (minopos_t)startX;
+    this->_tetY = (minopos_t)startY;
+    return false;
+}
+
+// assume pasted, dir = -1 for ccw, dir = 1 for cw
+bool matrix_rotate_piece(Matrix* this, int8_t dir) {
+    M_matrix_unpaste_tet(this);
+    // clamp range
+    if (dir > -1) dir = 1;
+    if (dir < 0) dir = -1;
+
+    uint8_t start_rot = this->_currentRot;
+    // loop rotation with modulo
+    this->_currentRot = (uint8_t)((uint8_t)(this->_currentRot + 4u) + dir) % 4u;
+    uint8_t end_rot = this->_currentRot;
+
+    if (M_matrix_paste_tet(this)) {
+        // success, no need to do any kicks
+        this->_hdropDirty = true;
+        return true;
+    } else {
+        // fail, attempt to shift the piece around
+        bool attempt = M_matrix_wallkick(this, start_rot, end_rot);
+        if (!attempt) { // failed to wallkick
+            this->_currentRot = start_rot;
+            M_matrix_paste_tet(this);
+        } else {
+            this->_hdropDirty = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool matrix_slide_piece(Matrix* this, int8_t shift) {
+    M_matrix_unpaste_tet(this);
+    this->_tetX += (minopos_t)shift;
+    if (M_matrix_paste_tet(this)) {
+        this->_hdropDirty = true;
+        return true;
+    } else {
+        this->_tetX -= (minopos_t)shift;
+        M_matrix_paste_tet(this);
+        return false;
+    }
+}
+
+uint16_t matrix_clear_lines(Matrix* this) {
+    size_t cell_row = (size_t)this->_ncols * sizeof(struct Mino);
+    size_t bit_row = this->_bbStride * sizeof(bbword_t);
+
+    // compact surviving rows towards the bottom, moving each contiguous run of them as one block
+    uint16_t lines_cleared = 0;
+    minopos_t y = (minopos_t)(this->_nrows - 1);
+    while (y >= 0) {
+        if (M_matrix_bb_row_full(this, y)) {
+            // everything above the lowest cleared row shifts down
+            if (lines_cleared == 0) M_matrix_damage_rows(this, 0, (minopos_t)(y + 1));
+            lines_cleared++;
+            y--;
+            continue;
+        }
+        minopos_t run_end = y; // inclusive
+        while (y >= 0 && !M_matrix_bb_row_full(this, y)) y--;
+        minopos_t run_start = (minopos_t)(y + 1);
+
+        if (lines_cleared > 0) {
+            size_t run_len = (size_t)(run_end - run_start + 1);
+            minopos_t dest = (minopos_t)(run_start + lines_cleared);
+            memmove(&MATRIX_AT(this, dest, 0), &MATRIX_AT(this, run_start, 0), run_len * cell_row);
+            memmove(M_matrix_bb_row(this, dest), M_matrix_bb_row(this, run_start), run_len * bit_row);
+        }
+    }
+
+    // rows that fell in from above the playfield are empty
+    memset(this->_board, 0, lines_cleared * cell_row);
+    M_matrix_clear_bits(this, 0, (minopos_t)lines_cleared);
+
+    if (lines_cleared > 0) {
+        M_matrix_scan_skyline(this, 0, this->_ncols);
+        this->_hdropDirty = true;
+    }
+
+    return lines_cleared;
+}
+
+bool matrix_add_garbage(Matrix* this, uint16_t lines, minopos_t hole) {
+    if (lines == 0) return true;
+    if (lines > this->_nrows) lines = (uint16_t)this->_nrows;
+    bool pasted = this->_piecePasted;
+    if (pasted) M_matrix_unpaste_tet(this);
+
+    // the top rows are pushed out, anything in them is lost
+    bool alive = true;
+    for (minopos_t x = 0; x < this->_ncols; x++) {
+        if (this->_colTop[x] < lines) alive = false;
+    }
+
+    size_t cell_row = (size_t)this->_ncols * sizeof(struct Mino);
+    size_t bit_row = this->_bbStride * sizeof(bbword_t);
+    size_t kept = (size_t)(this->_nrows - lines);
+    memmove(&MATRIX_AT(this, 0, 0), &MATRIX_AT(this, lines, 0), kept * cell_row);
+    memmove(M_matrix_bb_row(this, 0), M_matrix_bb_row(this, (minopos_t)lines), kept * bit_row);
+
+    minopos_t first = (minopos_t)(this->_nrows - lines);
+    M_matrix_clear_bits(this, first, this->_nrows);
+    for (minopos_t y = first; y < this->_nrows; y++) {
+        for (minopos_t x = 0; x < this->_ncols; x++) {
+            bool filled = x != hole;
+            MATRIX_AT(this, y, x).occupied = filled;
+            MATRIX_AT(this, y, x).type = (uint8_t)(filled ? GARBAGE : INVALID);
+            if (filled) M_matrix_bb_write(this, y, (unsigned)(x + BB_GUARD), 1, true);
+        }
+    }
+    M_matrix_scan_skyline(this, 0, this->_ncols);
+    M_matrix_damage_rows(this, 0, this->_nrows);
+    this->_hdropDirty = true;
+
+    if (pasted) {
+        // lift the piece out of the garbage, giving up once it would leave the board
+        while (!M_matrix_paste_tet(this)) {
+            struct PieceMask* pm = &TMask[PIECE_TO_INDEX(this->_currentPiece)][this->_currentRot];
+            if (this->_tetY + pm->top <= 0) return false;
+            this->_tetY--;
+        }
+    }
+    return alive;
+}
+
+bool matrix_apply_gravity(Matrix* this) {
+    this->_fallProgress += this->_gravity;
+    minopos_t rows = (minopos_t)(this->_fallProgress / MATRIX_ROW_ONE);
+    this->_fallProgress %= MATRIX_ROW_ONE;
+    // 20G is only about 19 rows a tick, top speed has to reach the floor of any board height
+    if (this->_gravityMilliG >= MATRIX_MAX_MILLI_G) rows = this->_nrows;
+    return rows == 0 || matrix_drop_rows(this, rows);
+}
+
+bool matrix_drop_rows(Matrix* this, minopos_t rows) {
+    // found again rather than trusting `_hdropDirty`, the bot and the move generator put the piece places directly.
+    // Above the skyline that's a few column reads, under an overhang it steps down like any collision test would.
+    M_matrix_set_hdrop_pos(this);
+    // the piece can't pass through anything on its way to the hard drop position, so it moves there in one step
+    minopos_t room = (minopos_t)(this->_hdropY - this->_tetY);
+    minopos_t fall = rows < room ? rows : room;
+    if (fall > 0) {
+        M_matrix_unpaste_tet(this);
+        this->_tetY = (minopos_t)(this->_tetY + fall);
+        M_matrix_paste_tet(this);
+    }
+    return fall == rows;
+}
+
+bool matrix_hold_piece(Matrix* this) {
+    if (!this->_holdAllowable) return true;
+
+    M_matrix_unpaste_tet(this);
+    
+    if (this->_heldPiece == INVALID) {
+        this->_heldPiece = this->_currentPiece;
+        bool ret =  matrix_respawn_tet_random(this);
+        this->_holdAllowable = false; // stop from holding twice in a row
+        return ret;
+    } else {
+        enum TetrominoType_t next = this->_heldPiece;
+        this->_heldPiece = this->_currentPiece;
+        matrix_set_current_piece(this, next, 0); // comes back in spawn orientation, with its own kicks
+        bool ret = matrix_respawn_tet(this);
+        this->_holdAllowable = false; // stop from holding twice in a row
+        return ret;
+    }
+    
+}
+// solidifies the current piece, return false is for failure to spawn
+bool M_matrix_lock(Matrix* this) {
+    M_matrix_unpaste_tet(this);
+    this->_tetY++;
+    // don't lock if piece can still fall
+    if (M_matrix_test_tet(this)) {
+        this->_tetY--;
+        M_matrix_paste_tet(this);
+        return true;
+    }
+    this->_tetY--;
+
+    bool is_stuck = M_matrix_test_if_stuck(this);
+
+    M_matrix_paste_tet(this);
+    // the piece is part of the board from here on
+    this->_piecePasted = false;
+    this->_locks++;
+    minopos_t first_col = this->_tetX > 0 ? this->_tetX : 0;
+    minopos_t end_col = this->_tetX + STATE_DIM < this->_ncols ? (minopos_t)(this->_tetX + STATE_DIM) : this->_ncols;
+    M_matrix_scan_skyline(this, first_col, end_col);
+
+    enum TetrominoType_t last_dropped = this->_currentPiece;
+    uint16_t lines_cleared = matrix_clear_lines(this);
+    this->_linesCleared += lines_cleared;
+
+    enum ComboType_t current_combo = M_matrix_check_combo_type(this, is_stuck, lines_cleared, last_dropped);
+
+    if (current_combo != NOTHING) {
+        this->_lastScoringPiece = last_dropped;
+        this->_lastPoints = M_matrix_add_score(this, current_combo);
+        this->_lastCombo = current_combo;
+        this->_comboAnimTimer = 0;
+        this->_comboCounts[current_combo]++;
+    }
+    this->_level = (uint32_t)this->_linesCleared / 10;
+    uint32_t milli_g;
+    if (this->_level > LEVEL_MAX) { 
+        this->_level = LEVEL_MAX;
+        // past the last level it keeps speeding up, twice the last level and once more every 20 lines, up to 20G
+        size_t steps = (this->_linesCleared - 150) / 20 + 2;
+        milli_g = steps < MATRIX_MAX_MILLI_G / LEVEL_MILLI_G[LEVEL_MAX] ? LEVEL_MILLI_G[LEVEL_MAX] * (uint32_t)steps : MATRIX_MAX_MILLI_G;
+    } else {
+        milli_g = LEVEL_MILLI_G[this->_level];
+    }
+    matrix_set_speed(this, milli_g, this->_lockDelayMs);
+
+    return matrix_respawn_tet_random(this);
+}
+
+bool matrix_apply_input(Matrix* this, enum Input_t input) {
+    switch (input) {
+        case INPUT_ROTATE_CW: matrix_rotate_piece(this, 1); break;
+        case INPUT_ROTATE_CCW: matrix_rotate_piece(this, -1); break;
+        case INPUT_SOFT_DROP: matrix_drop_rows(this, 1); break;
+        case INPUT_LEFT: matrix_slide_piece(this, -1); break;
+        case INPUT_RIGHT: matrix_slide_piece(this, 1); break;
+        case INPUT_HARD_DROP: matrix_hdrop(this); break;
+        case INPUT_HOLD: return matrix_hold_piece(this);
+        default: break;
+    }
+    return true;
+}
+
+void matrix_set_speed(Matrix* this, uint32_t milli_g, uint32_t lock_delay_ms) {
+    if (milli_g < 1) milli_g = 1;
+    if (milli_g > MATRIX_MAX_MILLI_G) milli_g = MATRIX_MAX_MILLI_G;
+    this->_gravityMilliG = milli_g;
+    this->_lockDelayMs = lock_delay_ms;
+    this->_gravity = (uint32_t)((uint64_t)milli_g * MATRIX_TICK_US * MATRIX_ROW_ONE / ((uint64_t)MATRIX_G_US * 1000));
+    this->_lockDelay = (uint32_t)(((uint64_t)lock_delay_ms * 1000 + MATRIX_TICK_US - 1) / MATRIX_TICK_US);
+}
+
+bool matrix_update(Matrix* this) {
+    this->_comboAnimTimer++;
+    if (this->_hdropDirty) M_matrix_set_hdrop_pos(this);
+    if (!M_matrix_hdrop(this)) return false;
+    if (this->_hdropDirty) M_matrix_set_hdrop_pos(this); // a hard drop brought in the next piece
+
+    // the lock delay runs every tick the piece rests on something, falling any further starts it over
+    if (this->_tetY >= this->_hdropY) {
+        this->_lockCounter++;
+        if (this->_lockCounter >= this->_lockDelay) return M_matrix_lock(this);
+        return true;
+    }
+    this->_lockCounter = 0;
+    matrix_apply_gravity(this);
+    return true;
+}
+
+void matrix_destruct(Matrix* this) {
+    if (this == NULL) return;
+    M_matrix_destroy_board(this);
+    free(this);
+}
+
+// mixes 8 bytes at a time, hashing is done every few ticks by replays so it needs to be quick on big boards
+static inline uint64_t M_hash_mix(uint64_t h, uint64_t v) {
+    h ^= v * 0x9e3779b97f4a7c15ull;
+    h = (h << 27) | (h >> 37);
+    return h * 0xbf58476d1ce4e5b9ull + 0x94d049bb133111ebull;
+}
+
+uint64_t matrix_hash(Matrix* this) {
+    uint64_t h = M_hash_mix(0, ((uint64_t)(uint16_t)this->_nrows << 16) | (uint16_t)this->_ncols);
+
+    const uint8_t* cells = (const uint8_t*)this->_board;
+    size_t len = (size_t)this->_nrows * (size_t)this->_ncols * sizeof(struct Mino);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, cells + i, 8);
+        h = M_hash_mix(h, v);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, cells + i, len - i);
+    h = M_hash_mix(h, tail);
+
+    h = M_hash_mix(h, ((uint64_t)(uint16_t)this->_tetX << 48) | ((uint64_t)(uint16_t)this->_tetY << 32)
+        | ((uint64_t)this->_currentRot << 16) | ((uint64_t)this->_currentPiece << 8) | (uint64_t)this->_heldPiece);
+    h = M_hash_mix(h, ((uint64_t)this->_lockCounter << 32) | this->_fallProgress);
+    h = M_hash_mix(h, this->_points);
+    h = M_hash_mix(h, this->_linesCleared);
+    h = M_hash_mix(h, this->_b2b);
+    for (int w = 0; w < 4; w++) h = M_hash_mix(h, this->_rng.s[w]);
+    for (uint8_t q = 0; q < this->_queueLen; q++) h = M_hash_mix(h, this->_queue[(this->_queueHead + q) % QUEUE_CAP]);
+    return h;
+}
+
+// every field that isn't derived from another one. Pointers and the bitboard are rebuilt on load.
+#define MATRIX_STATE_FIELDS(X) \
+    X(_nrows) X(_ncols) X(_rootX) X(_rootY) X(_tetX) X(_tetY) \
+    X(_hdropX) X(_hdropY) X(_hdropQueued) \
+    X(_fallProgress) X(_lockCounter) X(_lockDelay) X(_lockDelayMs) X(_pieceStopped) \
+    X(_currentPiece) X(_currentRot) X(_heldPiece) X(_holdAllowable) \
+    X(_gravity) X(_gravityMilliG) X(_level) X(_linesCleared) X(_points) X(_lastPoints) X(_b2b) X(_lastCombo) X(_lastScoringPiece) \
+    X(_comboAnimTimer) X(_comboCounts) X(_locks) X(_seed) X(_rng) X(_queue) X(_queueHead) X(_queueLen)
+
+bool matrix_save_state(Matrix* this, FILE* f) {
+    bool ok = true;
+    #define WRITE_FIELD(field) ok = ok && fwrite(&this->field, sizeof(this->field), 1, f) == 1;
+    MATRIX_STATE_FIELDS(WRITE_FIELD)
+    #undef WRITE_FIELD
+    size_t cell_count = (size_t)this->_nrows * (size_t)this->_ncols;
+    return ok && fwrite(this->_board, sizeof(struct Mino), cell_count, f) == cell_count;
+}
+
+bool matrix_load_state(Matrix* this, FILE* f) {
+    bool ok = true;
+    #define READ_FIELD(field) ok = ok && fread(&this->field, sizeof(this->field), 1, f) == 1;
+    MATRIX_STATE_FIELDS(READ_FIELD)
+    #undef READ_FIELD
+    if (!ok || this->_nrows < 1 || this->_ncols < 1 || this->_queueLen > QUEUE_CAP) return false;
+    if (this->_currentPiece < INVALID || this->_currentPiece > T || this->_heldPiece < INVALID || this->_heldPiece > T) return false;
+    if (this->_lastScoringPiece < INVALID || this->_lastScoringPiece > T || this->_lastCombo < NOTHING || this->_lastCombo >= COMBO_COUNT) return false;
+    // everything below indexes a table, a corrupt recording must not read past one
+    if (this->_currentRot > 3 || this->_queueHead >= QUEUE_CAP) return false;
+    for (uint8_t q = 0; q < this->_queueLen; q++) {
+        uint8_t type = this->_queue[(this->_queueHead + q) % QUEUE_CAP];
+        if (type < I || type > T) return false;
+    }
+    if (this->_currentPiece != INVALID) {
+        struct PieceMask* pm = &TMask[PIECE_TO_INDEX(this->_currentPiece)][this->_currentRot];
+        if (this->_tetX + pm->left < 0 || this->_tetX + pm->right > this->_ncols
+            || this->_tetY + pm->top < 0 || this->_tetY + pm->bottom > this->_nrows) return false;
+    }
+
+    M_matrix_make_board(this);
+    size_t cell_count = (size_t)this->_nrows * (size_t)this->_ncols;
+    if (fread(this->_board, sizeof(struct Mino), cell_count, f) != cell_count) return false;
+
+    // rebuild the bitboard from the cells, the current piece is already pasted in them
+    for (minopos_t y = 0; y < this->_nrows; y++) {
+        for (minopos_t x = 0; x < this->_ncols; x++) {
+            if (MATRIX_AT(this, y, x).occupied)
+                M_matrix_bb_write(this, y, (unsigned)(x + BB_GUARD), 1, true);
+        }
+    }
+    this->_currentPieceData = this->_currentPiece == INVALID ? NULL : &TData[PIECE_TO_INDEX(this->_currentPiece)];
+    this->_piecePasted = this->_currentPiece != INVALID;
+    M_matrix_scan_skyline(this, 0, this->_ncols);
+    this->_hdropDirty = true;
+    return true;
+}
+
+void matrix_take_damage(Matrix* this, minopos_t* top, minopos_t* bottom) {
+    *top = this->_damageTop;
+    *bottom = this->_damageBottom;
+    this->_damageTop = this->_nrows;
+    this->_damageBottom = 0;
+}
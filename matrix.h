@@ -0,0 +1,592 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+// Headless rules engine. Nothing in here may depend on curses, so it can run in batch jobs, benchmarks and tools without a TTY.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rng.h"
+
+// DEFINES ----------------------------------------
+#define ELMCOUNT(x) (sizeof(x) / sizeof(x[0]))
+
+// called before exiting on a fatal error, frontends use it to restore the terminal
+extern void (*matrix_fail_hook)();
+
+#define FAIL(msg) { \
+  if (matrix_fail_hook) matrix_fail_hook(); \
+  fprintf(stderr, msg); \
+  exit(1); \
+} 
+#define FAILF(msg, fmt...) { \
+  if (matrix_fail_hook) matrix_fail_hook(); \
+  fprintf(stderr, msg, fmt); \
+  exit(1); \
+} 
+// END DEFINES ---------------------------------------
+
+// STRUCTS -------------------------------------------
+struct Mino {
+    bool occupied;
+    uint8_t type; // enum TetrominoType_t of the piece the mino came from, frontends pick the color
+};
+
+#define TETCOUNT 7
+enum TetrominoType_t {
+    INVALID, I, J, L, S, Z, O, T,
+    GARBAGE // mino type of rows sent by an opponent, never a piece
+};
+
+#define STATE_DIM 4
+// Represents a single rotation
+struct TetrominoState {
+    struct Mino state[STATE_DIM][STATE_DIM];
+};
+// What the piece should do if attempting to rotate into an occupied cell
+struct WallkickDef {
+    int8_t offsets[4][2]; // Every element on the list is tried in priority order until an offset works.
+};
+// represents all rotations, as well as wallkicks
+struct TetrominoDef {
+    struct TetrominoState rotations[4];
+    struct WallkickDef wallkicks[4][4];
+};
+
+// the simulation advances in ticks of this length, however fast the frontend draws. Rule timings are given in
+// ms and G and turned into ticks with it.
+#define MATRIX_TICK_US 16000
+#define MATRIX_G_US 16667 // 1G is a fall of one row every 1/60 s
+#define MATRIX_LOCK_DELAY_MS 500 // how long a piece may rest on something before it locks
+#define MATRIX_MAX_MILLI_G 20000 // 20G, treated as an instant drop so pieces land the tick they spawn on any board
+#define MATRIX_ROW_ONE 65536 // one row in the fixed point fall speed and progress
+
+// upcoming pieces kept per game. Always holds at least one full bag, so that many pieces can be previewed.
+#define QUEUE_CAP (2 * TETCOUNT)
+
+#define PIECE_TO_INDEX(type) ((int)(type) - 1) // enum hack
+#define INDEX_TO_PIECE(type) ((enum TetrominoType_t)(type) + 1) // enum hack
+extern struct TetrominoDef TData[TETCOUNT];
+
+#define PIECE_MINOS 4 // cells of every piece
+
+// where a cell of a piece is, relative to the piece's position
+struct MinoOffset {
+    int8_t y, x;
+};
+
+// Occupancy of a single rotation, one bitmask per row and a list of the occupied cells. Derived from TData after
+// parsing, so the hot paths never walk the whole STATE_DIM square.
+struct PieceMask {
+    uint8_t rows[STATE_DIM]; // bit x is set if column x of the row is occupied
+    uint8_t top; // first non-empty row
+    uint8_t bottom; // one past the last non-empty row
+    uint8_t left; // first non-empty column
+    uint8_t right; // one past the last non-empty column
+    int8_t colBottom[STATE_DIM]; // lowest occupied row of each column, -1 for empty columns
+    struct MinoOffset cells[PIECE_MINOS]; // row by row, left to right
+};
+extern struct PieceMask TMask[TETCOUNT][4];
+
+#ifndef MATRIX_TEXT_DATA
+// TData and TMask as compiled from rotations.dat and wallkicks.dat at build time, in the generated gamedata.c
+extern const struct TetrominoDef TDataBuiltin[TETCOUNT];
+extern const struct PieceMask TMaskBuiltin[TETCOUNT][4];
+#endif
+
+// bitboard rows store column x at bit (x + BB_GUARD). Bits outside of the playfield are always set,
+// so they behave like walls and a piece can be tested with a shift and an AND per row.
+typedef uint64_t bbword_t;
+#define BB_WORD_BITS 64
+#define BB_GUARD STATE_DIM
+#define BB_ROW_WORDS(ncols) (((size_t)(ncols) + 2 * BB_GUARD + BB_WORD_BITS - 1) / BB_WORD_BITS)
+
+// board storage is a single block aligned to cache lines
+#define MATRIX_ALIGN 64
+#define ALIGN_UP(x, a) (((x) + (a) - 1) / (a) * (a))
+// access a cell of the flat, row-major board
+#define MATRIX_AT(m, y, x) ((m)->_board[(size_t)(y) * (size_t)(m)->_ncols + (size_t)(x)])
+
+
+// unit for game board positions
+typedef int16_t minopos_t;
+
+// different kinds of scoring conditions for line clears
+enum ComboType_t {
+    NOTHING,
+    SINGLE,
+    DOUBLE,
+    TRIPLE,
+    TETRIS,
+    MINI_T_SPIN,
+    T_SPIN_SINGLE,
+    T_SPIN_DOUBLE,
+    T_SPIN_TRIPLE,
+    B2B,
+    // some fun ones
+    I_SPIN,
+    J_SPIN,
+    L_SPIN,
+    S_SPIN,
+    Z_SPIN
+};
+#define COMBO_COUNT (Z_SPIN + 1)
+// player actions, what every frontend key (or bot, or replay) boils down to
+enum Input_t {
+    INPUT_NONE,
+    INPUT_ROTATE_CW,
+    INPUT_ROTATE_CCW,
+    INPUT_SOFT_DROP,
+    INPUT_LEFT,
+    INPUT_RIGHT,
+    INPUT_HARD_DROP,
+    INPUT_HOLD,
+    INPUT_COUNT
+};
+
+// The game board, handles most of game state
+struct Matrix_s {
+    minopos_t _nrows;
+    minopos_t _ncols;
+
+    // place where pieces start from
+    minopos_t _rootX;
+    minopos_t _rootY;
+
+    minopos_t _tetX;
+    minopos_t _tetY;
+
+    // drop position location if the piece were to fall all the way
+    minopos_t _hdropX;
+    minopos_t _hdropY;
+    bool _hdropQueued;
+    bool _hdropDirty; // the piece moved sideways, rotated or the board changed since `_hdropY` was found. Falling doesn't change it.
+    bool _piecePasted; // the current piece's cells are in the board, but not locked yet
+
+    uint32_t _fallProgress; // part of a row fallen but not moved yet, in MATRIX_ROW_ONE units
+
+    uint32_t _lockCounter; // ticks the piece has been resting on something
+    uint32_t _lockDelay; // ticks a piece may rest before it sticks, from `_lockDelayMs`
+    uint32_t _lockDelayMs;
+    bool _pieceStopped; // if the piece is currently nudging another piece
+
+    enum TetrominoType_t _currentPiece;
+    struct TetrominoDef* _currentPieceData; // should be updated at the same time as the piece
+    uint8_t _currentRot;
+
+    enum TetrominoType_t _heldPiece; // tetris holding
+    bool _holdAllowable;
+
+    uint32_t _gravity; // rows to fall each tick in MATRIX_ROW_ONE units, from `_gravityMilliG`
+    uint32_t _gravityMilliG; // fall speed of the current level, in thousandths of G
+    uint32_t _level;
+    size_t _linesCleared;
+    size_t _points;
+    size_t _lastPoints;
+    size_t _b2b;
+    enum ComboType_t _lastCombo;
+    enum TetrominoType_t _lastScoringPiece;
+
+    uint32_t _comboAnimTimer;
+    uint32_t _comboCounts[COMBO_COUNT]; // locks that scored each kind of clear or spin this game
+    uint32_t _locks; // pieces locked this game
+
+    // 7bag randomizer. Owned by the game, so games with the same seed always see the same pieces.
+    uint64_t _seed;
+    struct Rng _rng;
+    uint8_t _queue[QUEUE_CAP]; // ring of upcoming piece types, starting at `_queueHead`
+    uint8_t _queueHead;
+    uint8_t _queueLen;
+
+    // actual game data, `_nrows * _ncols` minos in row-major order. Index with `MATRIX_AT`.
+    struct Mino* _board;
+
+    // occupancy bitboard mirroring `_board`, `_bbStride` words per row. Only one word per row for boards up to 56 wide.
+    bbword_t* _bits;
+    size_t _bbStride;
+
+    // skyline of the locked cells, the current piece isn't part of it. Updated on lock, line clear and `matrix_set_cell`.
+    minopos_t* _colTop; // highest occupied row of each column, `_nrows` for empty columns
+    minopos_t* _colHole; // lowest empty row under `_colTop` of each column, -1 if the column has no holes
+
+    // single allocation backing `_bits`, `_board` and the skyline. Kept across resets while large enough.
+    void* _storage;
+    size_t _storageSize;
+
+    // rows [`_damageTop`, `_damageBottom`) whose cells changed since the last `matrix_take_damage`. Empty when top >= bottom.
+    minopos_t _damageTop;
+    minopos_t _damageBottom;
+};
+typedef struct Matrix_s Matrix;
+// END STRUCTS ---------------------------------------
+
+// FUNCTS --------------------------------------------
+
+/**
+ * Readable name of a scoring combo.
+ * @param combo The combo type
+ * @returns A static string, never NULL.
+ */
+const char* combo_to_name(enum ComboType_t combo);
+
+/**
+ * Converts from piece letter (I, O, J, L, S, Z, T) to enumerical value.
+ * @param tetromino_letter Letter most closely related to the piece shape.
+ * @returns Enumerical value representing the piece type.
+ */
+enum TetrominoType_t toType(char tetromino_letter);
+
+/**
+ * Parse the file containing wall kick data. Each piece has 4 possible offsets per rotation state pair.
+ * Wall kicks are a feature that allow pieces to rotate in circumstances they would normally not be able to. They also allow for certain spins.
+ * @warning An unknown bug prevents t-spin triples from one side, but not the other.
+ */
+void parse_kicks_file();
+
+/**
+ * Parse the file containing piece state data. Includes the shape of each piece and their rotations.
+ */
+void parse_rotations_file();
+
+/**
+ * Load the piece shapes and wall kicks. Copies the tables compiled into the binary, or when built with
+ * MATRIX_TEXT_DATA, parses wallkicks.dat and rotations.dat from the working directory.
+ */
+void parse_game_data();
+
+/**
+ * Derive the occupancy masks and cell lists in `TMask` from the parsed shapes in `TData`.
+ */
+void build_piece_masks();
+
+// member functs ------
+
+// private
+
+/**
+ * Creates the board data of the caller, based on internal state. Reuses the existing storage if it is large enough.
+ * @param this The instance of the calling object.
+ */
+void M_matrix_make_board(Matrix*);
+
+/**
+ * Destroys the board data of the caller.
+ * @param this The instance of the calling object.
+ */
+void M_matrix_destroy_board(Matrix*);
+
+/**
+ * Creates Matrix board data, with dimensions.
+ * @param this The instance of the calling object.
+ * @param p_nrows Number of rows (height)
+ * @param p_ncols Number of columns (width)
+ */
+void matrix_make_board_rs(Matrix*, minopos_t, minopos_t);
+
+/**
+ * Recompute the skyline of columns [first_col, end_col) from the board, leaving out the unlocked piece.
+ * @param this The instance of the calling object.
+ * @param first_col First column to scan.
+ * @param end_col One past the last column to scan.
+ */
+void M_matrix_scan_skyline(Matrix*, minopos_t, minopos_t);
+
+/**
+ * Does the same thing as paste_tet, but doesn't affect board data. Tests the piece's row masks against the bitboard.
+ * @param this The instance of the calling object.
+ * @returns `true` if a piece could fit in the current position, `false` if it could not.
+ */
+bool M_matrix_test_tet(Matrix*);
+
+/**
+ * Reference version of `M_matrix_test_tet` that walks the piece's 4x4 grid in `TData` instead of `TMask`.
+ * Only used to validate and benchmark the bitboard path and the derived tables.
+ * @param this The instance of the calling object.
+ * @returns `true` if a piece could fit in the current position, `false` if it could not.
+ */
+bool M_matrix_test_tet_cells(Matrix*);
+
+/**
+ * Places or removes a single locked mino, keeping the bitboard in sync. For setting up boards outside of normal play.
+ * @param this The instance of the calling object.
+ * @param y Row of the cell
+ * @param x Column of the cell
+ * @param type Piece type the mino came from, `INVALID` to empty the cell
+ */
+void matrix_set_cell(Matrix*, minopos_t, minopos_t, enum TetrominoType_t);
+
+/**
+ * Takes the next piece from the queue, refilling it with a freshly shuffled bag when it runs low.
+ * @param this The instance of the calling object.
+ * @returns The next piece type.
+ */
+enum TetrominoType_t M_matrix_bag_pick(Matrix*);
+
+/**
+ * Resets a range of bitboard rows to empty playfield (walls only).
+ * @param this The instance of the calling object.
+ * @param first_row First row to clear
+ * @param end_row One past the last row to clear
+ */
+void M_matrix_clear_bits(Matrix*, minopos_t, minopos_t);
+
+/**
+ * Adds the current tetromino to the board data.
+ * @param this The instance of the calling object.
+ * @returns `true` if a piece was pasted in the current position, `false` if it was not.
+ */
+bool M_matrix_paste_tet(Matrix*);
+
+/**
+ * Remove the current tetromino from the board data.
+ * @param this The instance of the calling object.
+ */
+void M_matrix_unpaste_tet(Matrix*);
+
+/**
+ * Sets the position of the lowest place the piece can currently reach.
+ * Reads it off the skyline when the piece is above it, otherwise steps the piece down. `matrix_update` only calls this when `_hdropDirty` is set.
+ * @param this The instance of the calling object.
+ */
+void M_matrix_set_hdrop_pos(Matrix*);
+
+/**
+ * Checks every direction to see if the current piece can move anywhere. Tests for spins.
+ * @param this The instance of the calling object.
+ * @returns `true` if stuck, `false` if not
+ */
+bool M_matrix_test_if_stuck(Matrix*);
+
+/**
+ * States that a piece is no longer dynamic and is instead part of the game board.
+ * @param this The instance of the calling object.
+ * @returns `true` if the lock succeeded, `false` if the piece failed to respawn (failure condition)
+ */
+bool M_matrix_lock(Matrix*);
+
+/**
+ * Instantly lower the current piece as far as it can go, and lock into place.
+ * @param this The instance of the calling object.
+ * @returns `true` if the drop succeeded, `false` if the piece failed to respawn (failure condition)
+ */
+bool M_matrix_hdrop(Matrix*);
+
+/**
+ * Tests the list of wallkicks specified in wallkicks.dat for the current piece.
+ * @param this The instance of the calling object.
+ * @returns `true` if a new position was found where the piece fits, `false` if no kick succeeded.
+ */
+bool M_matrix_wallkick(Matrix*, uint8_t, uint8_t);
+
+/**
+ * Checks board factors to determine which special scoring combo has occurred.
+ * @param this The instance of the calling object.
+ * @param is_stuck If the scoring piece could not move in any direction.
+ * @param lines_cleared Amount of lines cleared in the last lock alone.
+ * @param locked_piece The type of piece that caused the combo.
+ * @returns The combo type that occurred.
+ */
+enum ComboType_t M_matrix_check_combo_type(Matrix*, bool, uint16_t, enum TetrominoType_t);
+/**
+ * Calculate score based on combo type.
+ * @param this The instance of the calling object.
+ * @param current_combo The combo type returned by `M_matrix_check_combo_type`
+ * @returns The amount of points added to the total.
+ */
+size_t M_matrix_add_score(Matrix* this, enum ComboType_t current_combo);
+
+// public
+
+/**
+ * Initialize all default data for a Matrix (tetris game board)
+ * @returns A new heap-allocated `Matrix*` object for all game state. Free with `matrix_destruct(obj)`
+ */
+Matrix* matrix_construct();
+/**
+ * `matrix_construct` with the board sized for the games it will play, so starting them doesn't reallocate it.
+ * @param p_nrows Number of rows (height)
+ * @param p_ncols Number of columns (width)
+ * @returns A new heap-allocated `Matrix*`. Free with `matrix_destruct(obj)`
+ */
+Matrix* matrix_construct_rs(minopos_t, minopos_t);
+/**
+ * Puts a Matrix back into its starting state for a new game, without freeing it.
+ * Board storage is only reallocated if the new size doesn't fit in the old one.
+ * The piece generator carries on from where it was, call `matrix_seed` afterwards to deal a specific sequence.
+ * @param this The instance of the calling object.
+ * @param p_nrows Number of rows (height)
+ * @param p_ncols Number of columns (width)
+ */
+void matrix_reset(Matrix*, minopos_t, minopos_t);
+/**
+ * Deletes data associated with the current game.
+ * @param this The instance of the calling object.
+ * @warning param `this` should be set to NULL after call to avoid use-after-free.
+ */
+void matrix_destruct(Matrix*);
+/**
+ * Make `dst` an exact copy of `src`, board and generator included, so both play out the same from here.
+ * Reuses the board storage of `dst` when it is large enough, so copying between same-sized games doesn't allocate.
+ * @param dst A constructed Matrix to overwrite.
+ * @param src The game to copy.
+ */
+void matrix_copy(Matrix*, Matrix*);
+/**
+ * Sets the current piece
+ * @param this The instance of the calling object.
+ * @param kind The enum piece type to be set.
+ * @param rot_index A number (0-3) representing the initial rotation state of the piece.
+ */
+void matrix_set_current_piece(Matrix*, enum TetrominoType_t, uint8_t);
+/**
+ * Queues a piece to be instantly snapped to the floor and locked (hard dropping)
+ * @param this The instance of the calling object.
+ */
+void matrix_hdrop(Matrix*);
+/**
+ * Spawned the piece specified by `Matrix::_currentPiece` at `Matrix::_root<X/Y>`
+ * @param this The instance of the calling object.
+ * @warning Effective immediately, does not handle scoring, line clearing, or unpasting. Use to initialize.
+ * @returns `true` if the piece successfully spawned at `Matrix::_root<X/Y>`, `false` if not (failure condition)
+ */
+bool matrix_respawn_tet(Matrix*);
+/**
+ * Starts a game from scratch: resets to the given size, seeds the randomizer and spawns the first piece.
+ * Every tool that needs games to be reproducible from a seed starts them through here.
+ * @param this The instance of the calling object.
+ * @param p_nrows Number of rows (height)
+ * @param p_ncols Number of columns (width)
+ * @param seed Seed for the piece randomizer
+ * @returns `false` if the first piece could not spawn (failure condition)
+ */
+bool matrix_new_game(Matrix*, minopos_t, minopos_t, uint64_t);
+/**
+ * Seeds the piece randomizer and throws away any pieces already queued.
+ * @param this The instance of the calling object.
+ * @param seed Seed for the game's generator, the same seed always deals the same pieces.
+ */
+void matrix_seed(Matrix*, uint64_t);
+/**
+ * Looks at an upcoming piece without taking it.
+ * @param this The instance of the calling object.
+ * @param n How far ahead to look, `0` is the next piece to spawn. Must be less than `TETCOUNT`.
+ * @returns The piece type that will spawn `n` pieces from now.
+ */
+enum TetrominoType_t matrix_peek_piece(Matrix*, uint8_t);
+/**
+ * Sets the current piece to a random (7bag) tetromino, and spawns a new one at `Matrix::_root<X/Y>`
+ * @param this The instance of the calling object.
+ * @warning Effective immediately, does not handle scoring, line clearing, or unpasting. Use to initialize.
+ * @returns `true` if the piece successfully spawned at `Matrix::_root<X/Y>`, `false` if not (failure condition)
+ */
+bool matrix_respawn_tet_random(Matrix*);
+/**
+ * Rotates the current piece
+ * @param this The instance of the calling object.
+ * @param dir `-1` for counter-clockwise, `+1` for clockwise
+ * @returns `true` if the rotation succeeded, `false` if the rotation failed.
+ */
+bool matrix_rotate_piece(Matrix*, int8_t);
+/**
+ * Moves the current piece left or right.
+ * @param this The instance of the calling object.
+ * @param shift amount of positions left or right (-, +) to attempt to shift the piece.
+ * @returns `true` if the slide was successful, `false` if the slide failed.
+ */
+bool matrix_slide_piece(Matrix*, int8_t);
+/**
+ * Tests for line clears and removes full lines in place, shifting the rows above them downwards. Never allocates.
+ * @param this The instance of the calling object.
+ * @returns The count of lines cleared during the method call.
+ */
+uint16_t matrix_clear_lines(Matrix*);
+/**
+ * Pushes the board up and fills the bottom rows with garbage, each with one empty cell.
+ * The unlocked piece stays where it is, or moves up as far as it has to if the garbage reaches it.
+ * @param this The instance of the calling object.
+ * @param lines Rows to add.
+ * @param hole Column left empty in every added row.
+ * @returns `false` if a block was pushed off the top, or the piece no longer fits anywhere.
+ */
+bool matrix_add_garbage(Matrix*, uint16_t lines, minopos_t hole);
+/**
+ * Lowers the piece by one tick of `Matrix::_gravity`, carrying parts of a row over to the next tick.
+ * At `MATRIX_MAX_MILLI_G` it falls straight to the hard drop position instead.
+ * @param this The instance of the calling object.
+ * @returns `true` if the piece fell every whole row due, `false` if the piece was stopped from moving early.
+ */
+bool matrix_apply_gravity(Matrix*);
+/**
+ * Lowers the piece by up to `rows` positions. Finds the hard drop position first, whatever `_hdropDirty` says, then
+ * moves there in one step, every row down to it is free. Constant time while the piece is above the skyline.
+ * @param this The instance of the calling object.
+ * @param rows Rows to fall.
+ * @returns `true` if the piece managed to move all the way, `false` if the piece was stopped from moving early.
+ */
+bool matrix_drop_rows(Matrix*, minopos_t rows);
+/**
+ * "Holds" a piece for later, placing it in a variable and respawning the current piece.
+ * @param this The instance of the calling object.
+ * @returns Whether or not a game-ending condition has occurred
+ */
+bool matrix_hold_piece(Matrix*);
+/**
+ * Performs a single player action. Frontends, bots and replays all go through here so they stay in lockstep.
+ * @param this The instance of the calling object.
+ * @param input The action to perform.
+ * @returns Whether or not a game-ending condition has occurred.
+ */
+bool matrix_apply_input(Matrix*, enum Input_t);
+/** 
+ * Handle basic game logic. (moving piece down, locking pieces into place, processing hard drops)
+ * Advances the game by one tick of MATRIX_TICK_US.
+ * @param this The instance of the calling object.
+ * @returns Whether or not a game-ending condition has occurred.
+ */
+bool matrix_update(Matrix*);
+
+/**
+ * Set how fast pieces fall and how long they may rest before locking. Turned into ticks here, a game keeps these
+ * until the next lock changes the level.
+ * @param this The instance of the calling object.
+ * @param milli_g Fall speed in thousandths of G, from 1 to MATRIX_MAX_MILLI_G.
+ * @param lock_delay_ms Lock delay in ms.
+ */
+void matrix_set_speed(Matrix*, uint32_t milli_g, uint32_t lock_delay_ms);
+
+/**
+ * Hash of everything that affects how the game plays out from here: board, piece, queue and score.
+ * @param this The instance of the calling object.
+ * @returns A 64 bit hash, equal for equal game states.
+ */
+uint64_t matrix_hash(Matrix*);
+/**
+ * Writes the full game state, so the game can later be resumed from this exact point.
+ * @param this The instance of the calling object.
+ * @param f File to write to, written at the current position.
+ * @returns `false` on write error.
+ */
+bool matrix_save_state(Matrix*, FILE*);
+/**
+ * Restores a game state written by `matrix_save_state`, resizing the board if needed.
+ * @param this The instance of the calling object.
+ * @param f File to read from, read from the current position.
+ * @returns `false` if the state was truncated or invalid. The Matrix is unusable until reset in that case.
+ */
+bool matrix_load_state(Matrix*, FILE*);
+
+/**
+ * Hands the range of board rows changed since the last call to the renderer, and clears it.
+ * Covers pastes, locks, line clears and board resets; the ghost and stats aren't tracked here.
+ * @param this The instance of the calling object.
+ * @param top First changed row.
+ * @param bottom One past the last changed row. Nothing changed if `*top >= *bottom`.
+ */
+void matrix_take_damage(Matrix*, minopos_t*, minopos_t*);
+
+// end member functs --
+// END FUNCS ----------------------------------------
+
+#endif
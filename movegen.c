@@ -0,0 +1,189 @@
+#include "movegen.h"
+
+#include <string.h>
+
+// every way a piece can move before locking, hard drops land where soft drops end up so they add nothing
+static const enum Input_t MOVE_INPUTS[] = {INPUT_LEFT, INPUT_RIGHT, INPUT_ROTATE_CW, INPUT_ROTATE_CCW, INPUT_SOFT_DROP};
+
+struct MoveGen* movegen_construct() {
+    struct MoveGen* gen = (struct MoveGen*)calloc(1, sizeof(struct MoveGen));
+    if (gen == NULL) FAIL("Out of memory allocating the move generator.\n");
+    gen->work = matrix_construct();
+    return gen;
+}
+
+void movegen_destruct(struct MoveGen* gen) {
+    if (gen == NULL) return;
+    matrix_destruct(gen->work);
+    for (int d = 0; d < MOVEGEN_MAX_DEPTH; d++) {
+        matrix_destruct(gen->levels[d]);
+        free(gen->found[d]);
+    }
+    free(gen->seenState);
+    free(gen->seenShape);
+    free(gen->open);
+    free(gen);
+}
+
+// grows the buffers to fit every (rot, y, x) of the board, and starts a new stamp
+static void M_movegen_reserve(struct MoveGen* gen, Matrix* game) {
+    size_t slots = 4 * ((size_t)game->_nrows + STATE_DIM) * ((size_t)game->_ncols + STATE_DIM);
+    if (slots > gen->cap) {
+        free(gen->seenState);
+        free(gen->seenShape);
+        free(gen->open);
+        gen->seenState = (uint32_t*)calloc(slots, sizeof(uint32_t));
+        gen->seenShape = (uint32_t*)calloc(slots, sizeof(uint32_t));
+        gen->open = (struct Placement*)malloc(slots * sizeof(struct Placement));
+        if (gen->seenState == NULL || gen->seenShape == NULL || gen->open == NULL)
+            FAIL("Out of memory allocating the move generator's buffers.\n");
+        // placement lists are sized the same, reallocated as each depth is reached
+        for (int d = 0; d < MOVEGEN_MAX_DEPTH; d++) {
+            free(gen->found[d]);
+            gen->found[d] = NULL;
+        }
+        gen->cap = slots;
+        gen->stamp = 0;
+    }
+    gen->stamp++;
+    if (gen->stamp == 0) { // wrapped, old stamps could collide
+        memset(gen->seenState, 0, gen->cap * sizeof(uint32_t));
+        memset(gen->seenShape, 0, gen->cap * sizeof(uint32_t));
+        gen->stamp = 1;
+    }
+}
+
+static inline size_t M_movegen_key(Matrix* m, uint8_t rot, minopos_t y, minopos_t x) {
+    size_t w = (size_t)m->_ncols + STATE_DIM;
+    size_t h = (size_t)m->_nrows + STATE_DIM;
+    return ((size_t)rot * h + (size_t)(y + STATE_DIM)) * w + (size_t)(x + STATE_DIM);
+}
+
+// puts the unpasted piece of `m` somewhere, paste it again to finish
+static inline void M_movegen_set(Matrix* m, const struct Placement* p) {
+    M_matrix_unpaste_tet(m);
+    m->_tetX = p->x;
+    m->_tetY = p->y;
+    m->_currentRot = p->rot;
+    m->_hdropDirty = true;
+}
+
+// searches from spawn into `dst`, which has room for `gen->cap` placements
+static size_t M_movegen_search(struct MoveGen* gen, Matrix* game, struct Placement* dst) {
+    M_movegen_reserve(gen, game);
+    Matrix* m = gen->work;
+    if (game->_currentPiece == INVALID) return 0;
+    matrix_copy(m, game);
+    if (m->_piecePasted) M_matrix_unpaste_tet(m);
+
+    // rotations with the same cells map to one shape, found by comparing masks moved to their top left corner
+    const struct PieceMask* masks = TMask[PIECE_TO_INDEX(m->_currentPiece)];
+    uint8_t shape[4], left[4];
+    uint32_t norm[4];
+    for (uint8_t r = 0; r < 4; r++) {
+        uint8_t cols = 0;
+        for (uint8_t row = 0; row < STATE_DIM; row++) cols |= masks[r].rows[row];
+        left[r] = (uint8_t)__builtin_ctz(cols);
+        norm[r] = 0;
+        for (uint8_t row = masks[r].top; row < masks[r].bottom; row++)
+            norm[r] |= (uint32_t)(masks[r].rows[row] >> left[r]) << ((row - masks[r].top) * STATE_DIM);
+        shape[r] = r;
+        for (uint8_t o = 0; o < r; o++) {
+            if (norm[o] == norm[r]) {
+                shape[r] = shape[o];
+                break;
+            }
+        }
+    }
+
+    struct Placement start = {m->_rootX, m->_rootY, 0};
+    m->_tetX = start.x;
+    m->_tetY = start.y;
+    m->_currentRot = start.rot;
+    if (!M_matrix_paste_tet(m)) return 0;
+
+    size_t head = 0, tail = 0, count = 0;
+    gen->open[tail++] = start;
+    gen->seenState[M_movegen_key(m, 0, start.y, start.x)] = gen->stamp;
+
+    while (head < tail) {
+        struct Placement s = gen->open[head++];
+
+        // a position the piece can't fall out of is where it locks
+        M_movegen_set(m, &s);
+        m->_tetY++;
+        bool resting = !M_matrix_test_tet(m);
+        m->_tetY--;
+        M_matrix_paste_tet(m);
+        if (resting) {
+            size_t key = M_movegen_key(m, shape[s.rot], (minopos_t)(s.y + masks[s.rot].top), (minopos_t)(s.x + left[s.rot]));
+            if (gen->seenShape[key] != gen->stamp) {
+                gen->seenShape[key] = gen->stamp;
+                dst[count++] = s;
+            }
+        }
+
+        for (size_t i = 0; i < ELMCOUNT(MOVE_INPUTS); i++) {
+            matrix_apply_input(m, MOVE_INPUTS[i]);
+            struct Placement next = {m->_tetX, m->_tetY, m->_currentRot};
+            if (next.x == s.x && next.y == s.y && next.rot == s.rot) continue; // blocked, left where it was
+
+            size_t key = M_movegen_key(m, next.rot, next.y, next.x);
+            if (gen->seenState[key] != gen->stamp) {
+                gen->seenState[key] = gen->stamp;
+                gen->open[tail++] = next;
+            }
+            M_movegen_set(m, &s);
+            M_matrix_paste_tet(m);
+        }
+    }
+    return count;
+}
+
+static struct Placement* M_movegen_found(struct MoveGen* gen, int depth) {
+    if (gen->found[depth] == NULL) {
+        gen->found[depth] = (struct Placement*)malloc(gen->cap * sizeof(struct Placement));
+        if (gen->found[depth] == NULL) FAIL("Out of memory allocating the move generator's placement list.\n");
+    }
+    return gen->found[depth];
+}
+
+size_t movegen_generate(struct MoveGen* gen, Matrix* game, struct Placement** out) {
+    M_movegen_reserve(gen, game); // so the list below is sized for this board
+    *out = M_movegen_found(gen, 0);
+    return M_movegen_search(gen, game, *out);
+}
+
+bool movegen_play(Matrix* this, const struct Placement* p) {
+    if (this->_piecePasted) M_matrix_unpaste_tet(this);
+    this->_tetX = p->x;
+    this->_tetY = p->y;
+    this->_currentRot = p->rot;
+    M_matrix_paste_tet(this);
+    return M_matrix_lock(this);
+}
+
+static void M_movegen_perft(struct MoveGen* gen, Matrix* game, uint8_t level, uint8_t depth, uint64_t* per_depth) {
+    M_movegen_reserve(gen, game);
+    struct Placement* list = M_movegen_found(gen, level);
+    size_t count = M_movegen_search(gen, game, list);
+    per_depth[level] += count;
+    if (level + 1 == depth) return;
+
+    if (gen->levels[level] == NULL) gen->levels[level] = matrix_construct();
+    Matrix* child = gen->levels[level];
+    for (size_t i = 0; i < count; i++) {
+        matrix_copy(child, game);
+        if (!movegen_play(child, &list[i])) continue; // topped out
+        M_movegen_perft(gen, child, (uint8_t)(level + 1), depth, per_depth);
+    }
+}
+
+uint64_t movegen_perft(struct MoveGen* gen, Matrix* game, uint8_t depth, uint64_t* per_depth) {
+    uint64_t counts[MOVEGEN_MAX_DEPTH] = {0};
+    if (depth > MOVEGEN_MAX_DEPTH) depth = MOVEGEN_MAX_DEPTH;
+    if (depth == 0) return 1;
+    M_movegen_perft(gen, game, 0, depth, counts);
+    if (per_depth != NULL) memcpy(per_depth, counts, depth * sizeof(uint64_t));
+    return counts[depth - 1];
+}
@@ -0,0 +1,70 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+// Exhaustive placement generator. Searches every position the current piece can reach from spawn with the
+// game's own slide, rotate (every kick) and soft drop functions, so tucks and spins are included and nothing
+// illegal is. Also counts placements several pieces deep, perft style, as an oracle and a benchmark.
+
+#include "matrix.h"
+
+#define MOVEGEN_MAX_DEPTH 16
+
+// where a piece locks
+struct Placement {
+    minopos_t x, y;
+    uint8_t rot;
+};
+
+struct MoveGen {
+    Matrix* work; // the piece is walked around on this copy
+    Matrix* levels[MOVEGEN_MAX_DEPTH]; // board after each placement of a perft line
+    struct Placement* found[MOVEGEN_MAX_DEPTH]; // placements at each perft depth
+    size_t foundCap;
+
+    uint32_t* seenState; // stamp per (rot, y, x) reached
+    uint32_t* seenShape; // stamp per (shape, top, left) locked, so equal shapes from different rotations count once
+    uint32_t stamp;
+    struct Placement* open; // search queue
+    size_t cap; // entries in each of the above
+};
+
+/**
+ * Create a generator. Buffers grow to the largest board seen, after that generating doesn't allocate.
+ * @returns A heap allocated generator, free with `movegen_destruct`.
+ */
+struct MoveGen* movegen_construct();
+
+/**
+ * Free a generator.
+ * @param gen The generator, may be NULL.
+ */
+void movegen_destruct(struct MoveGen* gen);
+
+/**
+ * List every distinct lock position of the current piece, starting from spawn in rotation 0.
+ * Hold isn't used. Positions whose cells are the same are listed once.
+ * @param gen The generator.
+ * @param game The game, left as it was.
+ * @param out Receives the placements. Only valid until the next call.
+ * @returns Number of placements, 0 if the piece doesn't fit at spawn.
+ */
+size_t movegen_generate(struct MoveGen* gen, Matrix* game, struct Placement** out);
+
+/**
+ * Lock the current piece at a placement, which clears lines, scores and spawns the next piece.
+ * @param this The game.
+ * @param p A placement from `movegen_generate` for this game.
+ * @returns `false` if the next piece doesn't fit.
+ */
+bool movegen_play(Matrix*, const struct Placement* p);
+
+/**
+ * Count the placement sequences `depth` pieces long, following the game's queue.
+ * @param gen The generator.
+ * @param game The game to start from, left as it was.
+ * @param depth Pieces to place, at most MOVEGEN_MAX_DEPTH.
+ * @param per_depth If not NULL, receives the number of nodes at each depth, `depth` entries.
+ * @returns Number of leaf sequences. A line ends early, uncounted, when the next piece tops out.
+ */
+uint64_t movegen_perft(struct MoveGen* gen, Matrix* game, uint8_t depth, uint64_t* per_depth);
+
+#endif
@@ -0,0 +1,171 @@
+// Versus match between two processes over a Unix socket, played by headless policies. `game --host/--join` is
+// the same match with a person at the keyboard, either side can be one or the other.
+//   netplay --host /tmp/cursetris.sock      (waits for the other side)
+//   netplay --join /tmp/cursetris.sock
+#include <poll.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "matrix.h"
+#include "netsession.h"
+#include "policy.h"
+#include "versus.h"
+
+// same tick length as the terminal game
+#define FRAME_NS (MATRIX_TICK_US * 1000)
+#define MAX_CATCHUP_FRAMES 8
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void wait_readable(struct NetSession* ns, int timer_fd) {
+    struct pollfd fds[2] = {{.fd = ns->fd, .events = POLLIN}, {.fd = timer_fd, .events = POLLIN}};
+    poll(fds, timer_fd >= 0 ? 2 : 1, -1);
+}
+
+// decides this side's input for tick `match.tick + delay`, on a copy of its game advanced by the inputs already
+// scheduled, so a policy that plans whole pieces plans them from where the piece will actually be
+static enum Input_t decide(struct NetSession* np, Matrix* predict, const struct Policy* policy, void* policy_state) {
+    matrix_copy(predict, np->match.players[np->me].game);
+    bool alive = np->match.players[np->me].alive;
+    for (uint64_t t = np->match.tick; t < np->localCount && alive; t++)
+        alive = matrix_apply_input(predict, np->local[t % NETSESSION_TICK_RING]) && matrix_update(predict);
+    return alive ? policy->next(policy_state, predict) : INPUT_NONE;
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    bool host = false, fast = false, auto_delay = false, usage = false;
+    const char* policy_name = "bot";
+    const char* script = "llcsssh";
+    struct VersusHello hello = {1, 24, 10, 2, 0, {{0}}};
+    versus_default_attacks(&hello.attacks);
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--host") == 0 && has_value) { host = true; path = argv[++i]; }
+        else if (strcmp(argv[i], "--join") == 0 && has_value) path = argv[++i];
+        else if (strcmp(argv[i], "--policy") == 0 && has_value) policy_name = argv[++i];
+        else if (strcmp(argv[i], "--script") == 0 && has_value) script = argv[++i];
+        else if (strcmp(argv[i], "--seed") == 0 && has_value) hello.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--rows") == 0 && has_value) hello.rows = (minopos_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cols") == 0 && has_value) hello.cols = (minopos_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ticks") == 0 && has_value) hello.maxTicks = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--delay") == 0 && has_value) {
+            i++;
+            auto_delay = strcmp(argv[i], "auto") == 0;
+            if (!auto_delay) hello.inputDelay = (uint8_t)atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "--attacks") == 0 && has_value) {
+            if (!versus_parse_attacks(&hello.attacks, argv[++i])) {
+                fprintf(stderr, "attack table must be up to %d comma separated line counts\n", COMBO_COUNT - 1);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--fast") == 0) fast = true;
+        else usage = true;
+    }
+    const struct Policy* policy = policy_find(policy_name);
+    if (usage || path == NULL || policy == NULL) {
+        fprintf(stderr, "usage: %s (--host SOCKET | --join SOCKET) [--policy random|scripted|bot] [--script INPUTS]\n"
+            "          [--fast] [--seed N] [--rows N] [--cols N] [--ticks N] [--delay TICKS|auto]\n"
+            "          [--attacks N,N,...]\n"
+            "the host picks the seed, board, delay, tick limit and attack table. --fast runs ticks as soon as inputs allow.\n", argv[0]);
+        return 2;
+    }
+    if (hello.inputDelay < 1) hello.inputDelay = 1;
+    if (hello.inputDelay > NETSESSION_MAX_DELAY) hello.inputDelay = NETSESSION_MAX_DELAY;
+
+    parse_game_data();
+    struct NetSession* np = netsession_open(path, host);
+    if (np == NULL) {
+        fprintf(stderr, "could not %s %s\n", host ? "listen on" : "connect to", path);
+        return 1;
+    }
+    if (!netsession_handshake(np, &hello, FRAME_NS, auto_delay)) {
+        fprintf(stderr, "bad or missing hello from the host\n");
+        netsession_close(np, VERSUS_END_QUIT);
+        return 1;
+    }
+
+    Matrix* predict = matrix_construct();
+    void* policy_state = policy->create(script);
+    policy->start(policy_state, np->match.players[np->me].game, hello.seed + (uint64_t)np->me);
+
+    int timer_fd = -1;
+    if (!fast) {
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        struct itimerspec spec = {{0, FRAME_NS}, {0, FRAME_NS}};
+        timerfd_settime(timer_fd, 0, &spec, NULL);
+    }
+
+    uint64_t start = now_ns();
+    uint64_t ticks_due = fast ? UINT64_MAX : 0;
+    bool stalled = false;
+    enum VersusOutcome_t outcome = VERSUS_ONGOING;
+    bool time_up = false;
+    while (outcome == VERSUS_ONGOING && !np->desync) {
+        if (hello.maxTicks > 0 && np->match.tick >= hello.maxTicks) {
+            time_up = true;
+            break;
+        }
+        netsession_pump(np);
+        bool ready = netsession_ready(np);
+        if (!ready && np->peerGone) break;
+
+        if (ready && ticks_due > 0) {
+            stalled = false;
+            netsession_send_input(np, decide(np, predict, policy, policy_state));
+            outcome = netsession_step(np);
+            if (!fast) ticks_due--;
+            continue;
+        }
+
+        // waiting, on the peer or on the clock
+        if (!ready && ticks_due > 0 && !stalled) {
+            np->stalls++;
+            stalled = true;
+        }
+        wait_readable(np, timer_fd);
+        uint64_t frames = 0;
+        if (timer_fd >= 0 && read(timer_fd, &frames, sizeof(frames)) == sizeof(frames)) {
+            ticks_due += frames;
+            if (ticks_due > MAX_CATCHUP_FRAMES) ticks_due = MAX_CATCHUP_FRAMES;
+        }
+    }
+    double elapsed = (double)(now_ns() - start) * 1e-9;
+
+    // results still in flight are checked before saying goodbye, the peer may be a tick behind
+    netsession_pump(np);
+
+    uint64_t ticks = np->match.tick;
+    if (np->desync) printf("DESYNC at tick %lu: the peer's game no longer matches this side's copy of it\n", np->desyncTick);
+    else if (time_up) printf("tick limit reached, undecided after %lu ticks\n", ticks);
+    else if (outcome == VERSUS_ONGOING) printf("peer left at tick %lu\n", ticks);
+    else if (outcome == VERSUS_DRAW) printf("draw after %lu ticks\n", ticks);
+    else printf("%s after %lu ticks\n", (outcome == VERSUS_WON_0) == (np->me == 0) ? "won" : "lost", ticks);
+
+    for (int p = 0; p < 2; p++) {
+        struct VersusPlayer* pl = &np->match.players[p == 0 ? np->me : 1 - np->me];
+        printf("  %-5s %6zu lines cleared, %5lu garbage sent, %5lu received, %8zu points\n", p == 0 ? "you" : "peer",
+            pl->game->_linesCleared, pl->linesSent, pl->linesReceived, pl->game->_points);
+    }
+    printf("input delay %u ticks, %lu stalls, %lu results checked, %.1f bytes sent per tick, %.0f ticks/s\n",
+        np->delay, np->stalls, np->hashesChecked, ticks > 0 ? (double)np->bytesSent / (double)ticks : 0.0,
+        elapsed > 0 ? (double)ticks / elapsed : 0.0);
+    if (np->rttCount > 0) {
+        printf("round trip: min %.1f us, mean %.1f us, max %.1f us over %lu pings\n", (double)np->rttMin * 1e-3,
+            (double)np->rttSum / (double)np->rttCount * 1e-3, (double)np->rttMax * 1e-3, np->rttCount);
+    }
+
+    policy->destroy(policy_state);
+    matrix_destruct(predict);
+    if (timer_fd >= 0) close(timer_fd);
+    bool desync = np->desync;
+    netsession_close(np, desync ? VERSUS_END_DESYNC : outcome != VERSUS_ONGOING || time_up ? VERSUS_END_GAME_OVER : VERSUS_END_QUIT);
+    return desync ? 1 : 0;
+}
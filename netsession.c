@@ -0,0 +1,236 @@
+#include "netsession.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t M_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void M_send_bytes(struct NetSession* ns, const uint8_t* buf, size_t len) {
+    while (len > 0 && !ns->peerGone) {
+        ssize_t n = send(ns->fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ns->peerGone = true;
+            ns->peerEnd = VERSUS_END_QUIT;
+            return;
+        }
+        buf += n;
+        len -= (size_t)n;
+        ns->bytesSent += (uint64_t)n;
+    }
+}
+
+static void M_send_message(struct NetSession* ns, uint8_t tag, uint64_t body, int body_bytes) {
+    uint8_t buf[9];
+    buf[0] = tag;
+    for (int i = 0; i < body_bytes; i++) buf[1 + i] = (uint8_t)(body >> (8 * i));
+    M_send_bytes(ns, buf, (size_t)(1 + body_bytes));
+}
+
+static uint64_t M_read_le(const uint8_t* in, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= (uint64_t)in[i] << (8 * i);
+    return v;
+}
+
+static void M_check_result(struct NetSession* ns, uint64_t tick) {
+    struct NetTickResult* want = &ns->predicted[tick % NETSESSION_TICK_RING];
+    struct NetTickResult* got = &ns->reported[tick % NETSESSION_TICK_RING];
+    ns->hashesChecked++;
+    if (!ns->desync && (want->hash != got->hash || want->sent != got->sent)) {
+        ns->desync = true;
+        ns->desyncTick = tick;
+    }
+}
+
+static void M_handle_message(struct NetSession* ns, const uint8_t* msg) {
+    switch (msg[0]) {
+        case VERSUS_TAG_INPUT:
+            ns->remote[ns->remoteCount % NETSESSION_TICK_RING] = (enum Input_t)msg[1];
+            ns->remoteCount++;
+            break;
+        case VERSUS_TAG_RESULT: {
+            uint64_t tick = ns->reportedCount++;
+            ns->reported[tick % NETSESSION_TICK_RING].sent = msg[1];
+            ns->reported[tick % NETSESSION_TICK_RING].hash = (uint32_t)M_read_le(msg + 2, 4);
+            if (tick < ns->match.tick) M_check_result(ns, tick); // otherwise checked once simulated
+            break;
+        }
+        case VERSUS_TAG_PING:
+            M_send_message(ns, VERSUS_TAG_PONG, M_read_le(msg + 1, 8), 8);
+            break;
+        case VERSUS_TAG_PONG: {
+            uint64_t rtt = M_now_ns() - M_read_le(msg + 1, 8);
+            if (ns->rttCount == 0 || rtt < ns->rttMin) ns->rttMin = rtt;
+            if (rtt > ns->rttMax) ns->rttMax = rtt;
+            ns->rttSum += rtt;
+            ns->rttCount++;
+            break;
+        }
+        case VERSUS_TAG_BYE:
+            ns->peerGone = true;
+            ns->peerEnd = (enum VersusEnd_t)msg[1];
+            break;
+        default: break;
+    }
+}
+
+// reads whatever arrived and handles every whole message. A hello, if one is read, is copied to `hello_out`.
+static void M_pump(struct NetSession* ns, uint8_t* hello_out) {
+    while (!ns->peerGone) {
+        ssize_t n = recv(ns->fd, ns->in + ns->inLen, sizeof(ns->in) - ns->inLen, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) break; // nothing more for now
+        if (n == 0) {
+            ns->peerGone = true;
+            ns->peerEnd = VERSUS_END_QUIT;
+            break;
+        }
+        ns->inLen += (size_t)n;
+
+        size_t at = 0;
+        while (at < ns->inLen) {
+            size_t size = versus_message_size(ns->in[at]);
+            if (size == 0) { // garbage on the wire, nothing after it can be trusted
+                ns->peerGone = true;
+                ns->peerEnd = VERSUS_END_DESYNC;
+                return;
+            }
+            if (at + size > ns->inLen) break;
+            if (ns->in[at] == VERSUS_TAG_HELLO) {
+                if (hello_out != NULL) memcpy(hello_out, ns->in + at, size);
+            } else {
+                M_handle_message(ns, ns->in + at);
+            }
+            at += size;
+        }
+        memmove(ns->in, ns->in + at, ns->inLen - at);
+        ns->inLen -= at;
+    }
+}
+
+static void M_wait_readable(struct NetSession* ns) {
+    struct pollfd fds = {.fd = ns->fd, .events = POLLIN};
+    poll(&fds, 1, -1);
+}
+
+static int M_open_socket(const char* path, bool host) {
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (host) {
+        unlink(path);
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+            close(fd);
+            return -1;
+        }
+        int peer = accept(fd, NULL, NULL);
+        close(fd);
+        unlink(path);
+        return peer;
+    }
+    // the host may not be listening yet, keep trying for a few seconds
+    for (int attempt = 0; attempt < 100; attempt++) {
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+        usleep(50000);
+    }
+    close(fd);
+    return -1;
+}
+
+struct NetSession* netsession_open(const char* path, bool host) {
+    struct NetSession* ns = (struct NetSession*)calloc(1, sizeof(struct NetSession));
+    if (ns == NULL) FAIL("Out of memory allocating the session.\n");
+    ns->fd = M_open_socket(path, host);
+    if (ns->fd < 0) {
+        free(ns);
+        return NULL;
+    }
+    ns->me = host ? 0 : 1;
+    return ns;
+}
+
+bool netsession_handshake(struct NetSession* ns, struct VersusHello* hello, uint64_t tick_ns, bool auto_delay) {
+    // the joiner answers pings while it waits for the hello
+    uint8_t hello_msg[VERSUS_HELLO_SIZE] = {0};
+    if (ns->me == 0) {
+        for (int i = 0; auto_delay && i < NETSESSION_HANDSHAKE_PINGS && !ns->peerGone; i++) {
+            uint64_t before = ns->rttCount;
+            M_send_message(ns, VERSUS_TAG_PING, M_now_ns(), 8);
+            while (ns->rttCount == before && !ns->peerGone) {
+                M_wait_readable(ns);
+                M_pump(ns, NULL);
+            }
+        }
+        if (auto_delay && ns->rttCount > 0) {
+            // half a round trip, in whole ticks, plus one for the tick the input is made on
+            uint64_t ticks = (ns->rttMax / 2 + tick_ns - 1) / tick_ns + 1;
+            hello->inputDelay = (uint8_t)(ticks > NETSESSION_MAX_DELAY ? NETSESSION_MAX_DELAY : ticks);
+        }
+        M_send_bytes(ns, hello_msg, versus_write_hello(hello, hello_msg));
+    } else {
+        while (hello_msg[0] != VERSUS_TAG_HELLO && !ns->peerGone) {
+            M_wait_readable(ns);
+            M_pump(ns, hello_msg);
+        }
+        if (ns->peerGone || !versus_read_hello(hello_msg, hello) || hello->inputDelay > NETSESSION_MAX_DELAY) return false;
+    }
+    if (ns->peerGone) return false;
+
+    ns->delay = hello->inputDelay;
+    versus_begin(&ns->match, hello);
+    // the first `delay` ticks have no inputs, sending them tells the peer so
+    for (uint8_t t = 0; t < ns->delay; t++) netsession_send_input(ns, INPUT_NONE);
+    return true;
+}
+
+void netsession_pump(struct NetSession* ns) {
+    M_pump(ns, NULL);
+}
+
+bool netsession_ready(struct NetSession* ns) {
+    return ns->remoteCount > ns->match.tick;
+}
+
+void netsession_send_input(struct NetSession* ns, enum Input_t input) {
+    ns->local[ns->localCount++ % NETSESSION_TICK_RING] = input;
+    M_send_message(ns, VERSUS_TAG_INPUT, input, 1);
+}
+
+enum VersusOutcome_t netsession_step(struct NetSession* ns) {
+    uint64_t tick = ns->match.tick;
+    enum Input_t inputs[2];
+    inputs[ns->me] = ns->local[tick % NETSESSION_TICK_RING];
+    inputs[1 - ns->me] = ns->remote[tick % NETSESSION_TICK_RING];
+    enum VersusOutcome_t outcome = versus_step(&ns->match, inputs);
+
+    struct VersusPlayer* mine = &ns->match.players[ns->me];
+    struct VersusPlayer* theirs = &ns->match.players[1 - ns->me];
+    M_send_message(ns, VERSUS_TAG_RESULT, (uint64_t)mine->lastSent | ((uint64_t)versus_hash(mine->game) << 8), 5);
+    ns->predicted[tick % NETSESSION_TICK_RING].hash = versus_hash(theirs->game);
+    ns->predicted[tick % NETSESSION_TICK_RING].sent = (uint8_t)theirs->lastSent;
+    if (ns->reportedCount > tick) M_check_result(ns, tick);
+
+    if (tick % NETSESSION_PING_INTERVAL == 0) M_send_message(ns, VERSUS_TAG_PING, M_now_ns(), 8);
+    return outcome;
+}
+
+void netsession_close(struct NetSession* ns, enum VersusEnd_t why) {
+    M_send_message(ns, VERSUS_TAG_BYE, why, 1);
+    versus_end(&ns->match);
+    close(ns->fd);
+    free(ns);
+}
@@ -0,0 +1,98 @@
+#ifndef NETSESSION_H
+#define NETSESSION_H
+// One side of a versus match over a Unix socket, whoever provides its inputs: a headless policy in `netplay`, or
+// the keyboard in `game --host/--join`.
+// Lockstep with input delay: every input is scheduled a few ticks ahead and sent right away, so the peer
+// usually has it before it's needed, and a tick only runs once both inputs for it are in.
+
+#include "matrix.h"
+#include "versus.h"
+
+// inputs and results kept per side, indexed by tick. Needs to cover the input delay plus a tick of skew.
+#define NETSESSION_TICK_RING 256
+#define NETSESSION_MAX_DELAY 120
+#define NETSESSION_PING_INTERVAL 60 // ticks between latency samples
+#define NETSESSION_HANDSHAKE_PINGS 8 // samples taken before picking an automatic input delay
+
+struct NetTickResult {
+    uint32_t hash;
+    uint8_t sent;
+};
+
+struct NetSession {
+    int fd;
+    bool peerGone;
+    enum VersusEnd_t peerEnd;
+    uint8_t in[4096];
+    size_t inLen;
+    uint64_t bytesSent;
+
+    struct VersusMatch match;
+    int me; // 0 for the host
+    uint8_t delay;
+    enum Input_t local[NETSESSION_TICK_RING], remote[NETSESSION_TICK_RING];
+    uint64_t localCount, remoteCount; // inputs known, for ticks [0, count)
+    struct NetTickResult predicted[NETSESSION_TICK_RING]; // the peer's results as this side simulated them
+    struct NetTickResult reported[NETSESSION_TICK_RING]; // the peer's results as it reported them
+    uint64_t reportedCount;
+    uint64_t hashesChecked;
+    bool desync;
+    uint64_t desyncTick;
+
+    uint64_t rttMin, rttMax, rttSum, rttCount; // in ns
+    uint64_t stalls; // counted by the caller, times a tick was due but the peer's input wasn't in yet
+};
+
+/**
+ * Connect to the other side. The host waits for the peer to connect, the joiner retries for a few seconds.
+ * @param path Socket path, the host creates it and removes it once connected.
+ * @param host Which side this is.
+ * @returns A new session, NULL if the connection failed.
+ */
+struct NetSession* netsession_open(const char* path, bool host);
+
+/**
+ * Agree on the match and start it. The host measures the round trip first if asked to, then sends `hello`;
+ * the joiner waits for the host's.
+ * @param ns A session from `netsession_open`.
+ * @param hello The host's settings, overwritten with what the host sent on the joiner.
+ * @param tick_ns Tick length, to turn the round trip into an input delay.
+ * @param auto_delay Host only, replace the input delay with half the worst measured round trip.
+ * @returns `false` if the peer left or its hello was unusable.
+ */
+bool netsession_handshake(struct NetSession* ns, struct VersusHello* hello, uint64_t tick_ns, bool auto_delay);
+
+/**
+ * Handle everything that arrived, without blocking.
+ * @param ns The session.
+ */
+void netsession_pump(struct NetSession* ns);
+
+/**
+ * Whether the next tick can run, the peer's input for it is in.
+ * @param ns The session.
+ */
+bool netsession_ready(struct NetSession* ns);
+
+/**
+ * Schedule this side's input `delay` ticks ahead and send it. Exactly one per tick run, before `netsession_step`.
+ * @param ns The session.
+ * @param input The action, `INPUT_NONE` to wait.
+ */
+void netsession_send_input(struct NetSession* ns, enum Input_t input);
+
+/**
+ * Run the next tick of the match, then report this side's result and check the peer's. Only when ready.
+ * @param ns The session.
+ * @returns Whether the match is over, and who won.
+ */
+enum VersusOutcome_t netsession_step(struct NetSession* ns);
+
+/**
+ * Say goodbye, close the socket and free the session.
+ * @param ns The session.
+ * @param why What ended it, for the peer.
+ */
+void netsession_close(struct NetSession* ns, enum VersusEnd_t why);
+
+#endif
@@ -0,0 +1,128 @@
+// Counts every placement sequence a few pieces deep, like a chess perft. The counts only change when movement,
+// kicks or collision change, so they pin those down, and the time taken benchmarks them.
+#include <string.h>
+#include <time.h>
+
+#include "matrix.h"
+#include "movegen.h"
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static enum TetrominoType_t piece_from_char(char c) {
+    static const char piece_chars[] = ".IJLSZOT";
+    const char* at = strchr(piece_chars, c);
+    if (c == '\0' || at == NULL) return INVALID;
+    return (enum TetrominoType_t)(at - piece_chars);
+}
+
+// board file: one line per row, the last line is the bottom row. '.' and ' ' are empty,
+// piece letters fill a cell with that piece and anything else fills it with garbage.
+static bool load_board(Matrix* mat, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return false;
+    char lines[256][258];
+    int count = 0;
+    while (count < 256 && fgets(lines[count], sizeof(lines[count]), f) != NULL) count++;
+    fclose(f);
+
+    for (int i = 0; i < count; i++) {
+        minopos_t y = (minopos_t)(mat->_nrows - count + i);
+        for (minopos_t x = 0; x < mat->_ncols && lines[i][x] != '\0' && lines[i][x] != '\n'; x++) {
+            char c = lines[i][x];
+            if (c == '.' || c == ' ') continue;
+            enum TetrominoType_t type = piece_from_char(c);
+            matrix_set_cell(mat, y, x, type == INVALID ? GARBAGE : type);
+        }
+    }
+    return true;
+}
+
+// replaces the current piece and the start of the queue, the bag carries on after them
+static bool load_queue(Matrix* mat, const char* queue) {
+    size_t n = strlen(queue);
+    if (n == 0 || n > QUEUE_CAP + 1) return false;
+    enum TetrominoType_t pieces[QUEUE_CAP + 1];
+    for (size_t i = 0; i < n; i++) {
+        pieces[i] = piece_from_char(queue[i]);
+        if (pieces[i] == INVALID) return false;
+    }
+    matrix_set_current_piece(mat, pieces[0], 0);
+    mat->_queueHead = 0;
+    mat->_queueLen = (uint8_t)(n - 1);
+    for (size_t i = 1; i < n; i++) mat->_queue[i - 1] = (uint8_t)pieces[i];
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int depth = 3;
+    int rows = 24, cols = 10;
+    uint64_t seed = 1;
+    const char* board_path = NULL;
+    const char* queue = NULL;
+    bool list = false;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--depth") == 0 && has_value) depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rows") == 0 && has_value) rows = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cols") == 0 && has_value) cols = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && has_value) seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--board") == 0 && has_value) board_path = argv[++i];
+        else if (strcmp(argv[i], "--queue") == 0 && has_value) queue = argv[++i];
+        else if (strcmp(argv[i], "--list") == 0) list = true;
+        else {
+            fprintf(stderr, "usage: %s [--depth N] [--rows N] [--cols N] [--seed N] [--board FILE] [--queue PIECES] [--list]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (depth < 1 || depth > MOVEGEN_MAX_DEPTH || rows < 4 || rows > 255 || cols < 4 || cols > 255) {
+        fprintf(stderr, "depth must be 1 to %d, the board 4 to 255 each way\n", MOVEGEN_MAX_DEPTH);
+        return 2;
+    }
+
+    parse_game_data();
+    Matrix* mat = matrix_construct_rs((minopos_t)rows, (minopos_t)cols);
+    matrix_new_game(mat, (minopos_t)rows, (minopos_t)cols, seed);
+    M_matrix_unpaste_tet(mat);
+    if (board_path != NULL && !load_board(mat, board_path)) {
+        fprintf(stderr, "could not read %s\n", board_path);
+        matrix_destruct(mat);
+        return 1;
+    }
+    if (queue != NULL && !load_queue(mat, queue)) {
+        fprintf(stderr, "queue must be 1 to %d of the letters IJLSZOT\n", QUEUE_CAP + 1);
+        matrix_destruct(mat);
+        return 1;
+    }
+    if (!matrix_respawn_tet(mat)) {
+        fprintf(stderr, "the first piece doesn't fit at spawn\n");
+        matrix_destruct(mat);
+        return 1;
+    }
+
+    struct MoveGen* gen = movegen_construct();
+    if (list) {
+        struct Placement* found;
+        size_t n = movegen_generate(gen, mat, &found);
+        for (size_t i = 0; i < n; i++) printf("x %d y %d rot %u\n", found[i].x, found[i].y, found[i].rot);
+    }
+
+    uint64_t per_depth[MOVEGEN_MAX_DEPTH];
+    double start = now_seconds();
+    movegen_perft(gen, mat, (uint8_t)depth, per_depth);
+    double elapsed = now_seconds() - start;
+
+    uint64_t nodes = 0;
+    for (int d = 0; d < depth; d++) {
+        printf("depth %d: %lu\n", d + 1, per_depth[d]);
+        nodes += per_depth[d];
+    }
+    printf("%lu nodes in %.3f s (%.0f nodes/s)\n", nodes, elapsed, (double)nodes / elapsed);
+
+    movegen_destruct(gen);
+    matrix_destruct(mat);
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "policy.h"
+
+#include <string.h>
+
+#include "bot.h"
+
+// random: a random input most ticks, hard drops mostly replaced by soft drops so pieces travel a bit
+static void* random_create(const char* script_text) {
+    (void)script_text;
+    struct Rng* rng = (struct Rng*)malloc(sizeof(struct Rng));
+    if (rng == NULL) FAIL("Out of memory allocating a policy.\n");
+    return rng;
+}
+
+static void random_start(void* state, Matrix* game, uint64_t seed) {
+    (void)game;
+    rng_seed((struct Rng*)state, ~seed);
+}
+
+static enum Input_t random_next(void* state, Matrix* game) {
+    (void)game;
+    struct Rng* rng = (struct Rng*)state;
+    uint32_t roll = rng_below(rng, 16);
+    enum Input_t input = roll < INPUT_COUNT - 1 ? (enum Input_t)(roll + 1) : INPUT_NONE;
+    if (input == INPUT_HARD_DROP && rng_below(rng, 4) != 0) input = INPUT_SOFT_DROP;
+    return input;
+}
+
+// scripted: cycles through a fixed string of inputs
+struct Script {
+    enum Input_t* inputs;
+    size_t len, at;
+};
+
+static enum Input_t input_from_char(char c) {
+    switch (c) {
+        case 'l': return INPUT_LEFT;
+        case 'r': return INPUT_RIGHT;
+        case 'c': return INPUT_ROTATE_CW;
+        case 'w': return INPUT_ROTATE_CCW;
+        case 's': return INPUT_SOFT_DROP;
+        case 'h': return INPUT_HARD_DROP;
+        case 'x': return INPUT_HOLD;
+        default: return INPUT_NONE;
+    }
+}
+
+static void* script_create(const char* script_text) {
+    struct Script* script = (struct Script*)calloc(1, sizeof(struct Script));
+    size_t len = strlen(script_text);
+    if (script != NULL) script->inputs = (enum Input_t*)malloc((len > 0 ? len : 1) * sizeof(enum Input_t));
+    if (script == NULL || script->inputs == NULL) FAIL("Out of memory allocating a policy.\n");
+    for (size_t i = 0; i < len; i++) script->inputs[i] = input_from_char(script_text[i]);
+    script->len = len > 0 ? len : 1;
+    if (len == 0) script->inputs[0] = INPUT_HARD_DROP;
+    return script;
+}
+
+static void script_destroy(void* state) {
+    struct Script* script = (struct Script*)state;
+    free(script->inputs);
+    free(script);
+}
+
+static void script_start(void* state, Matrix* game, uint64_t seed) {
+    (void)game;
+    (void)seed;
+    ((struct Script*)state)->at = 0;
+}
+
+static enum Input_t script_next(void* state, Matrix* game) {
+    (void)game;
+    struct Script* script = (struct Script*)state;
+    enum Input_t input = script->inputs[script->at];
+    script->at = (script->at + 1) % script->len;
+    return input;
+}
+
+// bot: thinks once per piece with no time budget, so results don't depend on machine load, then plays the path
+#define BOT_PATH_CAP (4 + 2 * 256)
+struct BotPlayer {
+    struct Bot* bot;
+    enum Input_t path[BOT_PATH_CAP];
+    size_t len, at;
+};
+
+static void* bot_create(const char* script_text) {
+    (void)script_text;
+    struct BotPlayer* player = (struct BotPlayer*)calloc(1, sizeof(struct BotPlayer));
+    if (player == NULL) FAIL("Out of memory allocating a policy.\n");
+    struct BotConfig bot_config;
+    bot_default_config(&bot_config);
+    bot_config.budgetUs = 0;
+    player->bot = bot_construct(&bot_config);
+    return player;
+}
+
+static void bot_destroy(void* state) {
+    struct BotPlayer* player = (struct BotPlayer*)state;
+    bot_destruct(player->bot);
+    free(player);
+}
+
+static void bot_start(void* state, Matrix* game, uint64_t seed) {
+    (void)game;
+    (void)seed;
+    struct BotPlayer* player = (struct BotPlayer*)state;
+    player->len = 0;
+    player->at = 0;
+}
+
+static enum Input_t bot_next(void* state, Matrix* game) {
+    struct BotPlayer* player = (struct BotPlayer*)state;
+    if (player->at == player->len) {
+        struct BotMove move;
+        player->at = 0;
+        // every placement tops out, drop it and let the game end
+        player->len = bot_think(player->bot, game, &move) ? bot_move_path(&move, player->path, BOT_PATH_CAP) : 0;
+        if (player->len == 0) return INPUT_HARD_DROP;
+    }
+    return player->path[player->at++];
+}
+
+static const struct Policy POLICIES[] = {
+    {"random", random_create, free, random_start, random_next},
+    {"scripted", script_create, script_destroy, script_start, script_next},
+    {"bot", bot_create, bot_destroy, bot_start, bot_next},
+};
+
+const struct Policy* policy_find(const char* name) {
+    for (size_t p = 0; p < ELMCOUNT(POLICIES); p++) {
+        if (strcmp(POLICIES[p].name, name) == 0) return &POLICIES[p];
+    }
+    return NULL;
+}
@@ -0,0 +1,28 @@
+#ifndef POLICY_H
+#define POLICY_H
+// Headless players: input sources that decide, tick by tick, what a player presses.
+// Used wherever games run without a keyboard, like tournaments and versus matches.
+
+#include "matrix.h"
+
+// an input source. Each player gets its own instance, `start` puts it back to a clean state before every game.
+struct Policy {
+    const char* name;
+    void* (*create)(const char* script); // `script` is only read by the scripted policy
+    void (*destroy)(void*);
+    void (*start)(void*, Matrix*, uint64_t seed);
+    enum Input_t (*next)(void*, Matrix*);
+};
+
+/**
+ * Look a policy up by name.
+ * @param name "random", "scripted" or "bot".
+ *  - random: a random input most ticks.
+ *  - scripted: cycles through a string of inputs, l left, r right, c cw, w ccw, s soft drop, h hard drop, x hold,
+ *    anything else waits.
+ *  - bot: plays `bot_think` placements, with no time budget so results don't depend on machine load.
+ * @returns The policy, NULL if there is none by that name.
+ */
+const struct Policy* policy_find(const char* name);
+
+#endif
@@ -0,0 +1,318 @@
+#include "replay.h"
+
+#include <string.h>
+
+// LEB128 style, 7 bits per byte
+static void write_varint(FILE* f, uint64_t v) {
+    while (v >= 0x80) {
+        fputc((int)((v & 0x7f) | 0x80), f);
+        v >>= 7;
+    }
+    fputc((int)v, f);
+}
+
+static bool read_varint(FILE* f, uint64_t* out) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(f);
+        if (byte == EOF) return false;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+#define WRITE_RAW(f, x) fwrite(&(x), sizeof(x), 1, (f))
+#define READ_RAW(f, x) (fread(&(x), sizeof(x), 1, (f)) == 1)
+
+static uint32_t short_hash(Matrix* mat) {
+    uint64_t h = matrix_hash(mat);
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static void write_record_start(struct ReplayWriter* w, uint8_t tag, uint64_t tick) {
+    fputc(tag, w->file);
+    write_varint(w->file, tick - w->lastTick);
+    w->lastTick = tick;
+}
+
+bool replay_writer_open(struct ReplayWriter* w, const char* path, Matrix* mat) {
+    w->file = fopen(path, "wb");
+    if (w->file == NULL) return false;
+    w->lastTick = 0;
+    w->nextKeyframe = REPLAY_KEYFRAME_INTERVAL;
+
+    uint16_t version = REPLAY_VERSION;
+    fwrite(REPLAY_MAGIC, 1, 4, w->file);
+    WRITE_RAW(w->file, version);
+    WRITE_RAW(w->file, mat->_seed);
+    WRITE_RAW(w->file, mat->_nrows);
+    WRITE_RAW(w->file, mat->_ncols);
+    return true;
+}
+
+void replay_record_input(struct ReplayWriter* w, uint64_t tick, enum Input_t input) {
+    if (w->file == NULL || input == INPUT_NONE) return;
+    write_record_start(w, (uint8_t)(REPLAY_TAG_INPUT + input), tick);
+}
+
+void replay_record_tick(struct ReplayWriter* w, uint64_t tick, Matrix* mat) {
+    if (w->file == NULL) return;
+    // every tick, so playback points at the first tick that diverged even if it had no input
+    uint32_t hash = short_hash(mat);
+    write_record_start(w, REPLAY_TAG_HASH, tick);
+    WRITE_RAW(w->file, hash);
+    if (tick >= w->nextKeyframe) {
+        write_record_start(w, REPLAY_TAG_KEYFRAME, tick);
+        // length isn't known until the state is written, patch it afterwards
+        uint32_t len = 0;
+        long len_pos = ftell(w->file);
+        WRITE_RAW(w->file, len);
+        matrix_save_state(mat, w->file);
+        long end_pos = ftell(w->file);
+        len = (uint32_t)(end_pos - len_pos - (long)sizeof(len));
+        fseek(w->file, len_pos, SEEK_SET);
+        WRITE_RAW(w->file, len);
+        fseek(w->file, end_pos, SEEK_SET);
+        w->nextKeyframe = tick + REPLAY_KEYFRAME_INTERVAL;
+    }
+}
+
+void replay_writer_close(struct ReplayWriter* w, uint64_t tick, Matrix* mat, enum ReplayEnd_t reason) {
+    if (w->file == NULL) return;
+    uint8_t reason_byte = (uint8_t)reason;
+    uint64_t points = mat->_points;
+    uint64_t lines = mat->_linesCleared;
+    uint32_t hash = short_hash(mat);
+    write_record_start(w, REPLAY_TAG_END, tick);
+    WRITE_RAW(w->file, reason_byte);
+    WRITE_RAW(w->file, points);
+    WRITE_RAW(w->file, lines);
+    WRITE_RAW(w->file, hash);
+    fclose(w->file);
+    w->file = NULL;
+}
+
+// playback ---
+
+struct ReplayReader {
+    FILE* file;
+    uint64_t lastTick;
+    Matrix* mat;
+    uint64_t done; // updates completed, the next update to run is for tick `done`
+    bool alive;
+    uint64_t deathTick;
+};
+
+static bool reader_open(struct ReplayReader* r, const char* path, Matrix* mat) {
+    r->file = fopen(path, "rb");
+    if (r->file == NULL) return false;
+
+    char magic[4];
+    uint16_t version;
+    uint64_t seed;
+    minopos_t nrows, ncols;
+    if (fread(magic, 1, 4, r->file) != 4 || memcmp(magic, REPLAY_MAGIC, 4) != 0
+        || !READ_RAW(r->file, version) || version != REPLAY_VERSION
+        || !READ_RAW(r->file, seed) || !READ_RAW(r->file, nrows) || !READ_RAW(r->file, ncols)
+        || nrows < 1 || ncols < 1) {
+        fclose(r->file);
+        r->file = NULL;
+        return false;
+    }
+    r->lastTick = 0;
+    r->mat = mat;
+    r->done = 0;
+    r->alive = matrix_new_game(mat, nrows, ncols, seed);
+    r->deathTick = 0;
+    return true;
+}
+
+static bool reader_next(struct ReplayReader* r, uint8_t* tag, uint64_t* tick) {
+    int byte = fgetc(r->file);
+    uint64_t delta;
+    if (byte == EOF || !read_varint(r->file, &delta)) return false;
+    *tag = (uint8_t)byte;
+    r->lastTick += delta;
+    *tick = r->lastTick;
+    return true;
+}
+
+// runs updates until `end_tick` updates have been done, or the game ends
+static void reader_advance(struct ReplayReader* r, uint64_t end_tick) {
+    while (r->alive && r->done < end_tick) {
+        if (!matrix_update(r->mat)) {
+            r->alive = false;
+            r->deathTick = r->done;
+        }
+        r->done++;
+    }
+}
+
+static void set_error(struct ReplayResult* res, uint64_t tick, const char* msg) {
+    if (!res->ok) return; // keep the first one
+    res->ok = false;
+    res->firstMismatchTick = tick;
+    snprintf(res->error, sizeof(res->error), "%s", msg);
+}
+
+bool replay_verify(const char* path, Matrix* mat, struct ReplayResult* res) {
+    memset(res, 0, sizeof(*res));
+    res->ok = true;
+
+    struct ReplayReader r;
+    if (!reader_open(&r, path, mat)) {
+        set_error(res, 0, "could not open recording, or bad header");
+        return false;
+    }
+    Matrix* keyframe = NULL;
+    // the latest keyframe played forward next to the recording, the way `replay_seek` would, until the next one
+    struct ReplayReader seek = {0};
+
+    uint8_t tag;
+    uint64_t tick;
+    bool ended = false;
+    while (!ended && res->ok && reader_next(&r, &tag, &tick)) {
+        if (tag < REPLAY_TAG_INPUT + INPUT_COUNT) {
+            reader_advance(&r, tick);
+            if (!r.alive) {
+                set_error(res, tick, "input recorded after the game ended");
+                break;
+            }
+            res->inputs++;
+            if (!matrix_apply_input(mat, (enum Input_t)(tag - REPLAY_TAG_INPUT))) {
+                r.alive = false;
+                r.deathTick = tick;
+            }
+            if (seek.mat != NULL) {
+                reader_advance(&seek, tick);
+                if (seek.alive && !matrix_apply_input(seek.mat, (enum Input_t)(tag - REPLAY_TAG_INPUT))) seek.alive = false;
+            }
+            continue;
+        }
+        switch (tag) {
+            case REPLAY_TAG_HASH: {
+                uint32_t expected;
+                if (!READ_RAW(r.file, expected)) {
+                    set_error(res, tick, "truncated hash record");
+                    break;
+                }
+                reader_advance(&r, tick + 1);
+                res->hashesChecked++;
+                if (short_hash(mat) != expected) set_error(res, tick, "board hash mismatch");
+                if (seek.mat != NULL) {
+                    reader_advance(&seek, tick + 1);
+                    if (matrix_hash(seek.mat) != matrix_hash(mat)) set_error(res, tick, "seeking from the last keyframe gives a different state");
+                }
+            } break;
+            case REPLAY_TAG_KEYFRAME: {
+                uint32_t len;
+                if (!READ_RAW(r.file, len)) {
+                    set_error(res, tick, "truncated keyframe");
+                    break;
+                }
+                reader_advance(&r, tick + 1);
+                if (keyframe == NULL) keyframe = matrix_construct();
+                if (!matrix_load_state(keyframe, r.file)) {
+                    set_error(res, tick, "unreadable keyframe");
+                    break;
+                }
+                res->keyframesChecked++;
+                if (matrix_hash(keyframe) != matrix_hash(mat)) set_error(res, tick, "keyframe state mismatch");
+                seek.mat = keyframe;
+                seek.done = tick + 1;
+                seek.alive = r.alive;
+            } break;
+            case REPLAY_TAG_END: {
+                uint8_t reason;
+                uint64_t points, lines;
+                uint32_t hash;
+                if (!READ_RAW(r.file, reason) || !READ_RAW(r.file, points) || !READ_RAW(r.file, lines) || !READ_RAW(r.file, hash)) {
+                    set_error(res, tick, "truncated end record");
+                    break;
+                }
+                ended = true;
+                if (reason == REPLAY_END_DEATH) {
+                    reader_advance(&r, tick + 1);
+                    if (r.alive || r.deathTick != tick) set_error(res, tick, "game did not end on the recorded tick");
+                } else {
+                    reader_advance(&r, tick);
+                    if (!r.alive) set_error(res, r.deathTick, "game ended before the recording did");
+                }
+                if (points != mat->_points || lines != mat->_linesCleared) set_error(res, tick, "final score mismatch");
+                else if (hash != short_hash(mat)) set_error(res, tick, "final board hash mismatch");
+            } break;
+            default:
+                set_error(res, tick, "unknown record");
+            break;
+        }
+    }
+    if (res->ok && !ended) set_error(res, r.lastTick, "recording ends without an end record");
+
+    res->ticks = r.done;
+    res->points = mat->_points;
+    res->linesCleared = mat->_linesCleared;
+    matrix_destruct(keyframe);
+    fclose(r.file);
+    return res->ok;
+}
+
+uint64_t replay_seek(const char* path, uint64_t target, Matrix* mat) {
+    struct ReplayReader r;
+    if (!reader_open(&r, path, mat)) return UINT64_MAX;
+
+    // first pass, find the last keyframe at or before the target without simulating anything
+    long resume_pos = ftell(r.file);
+    uint64_t resume_tick = 0;
+    long keyframe_pos = -1;
+    uint8_t tag;
+    uint64_t tick;
+    while (reader_next(&r, &tag, &tick) && tick <= target) {
+        if (tag < REPLAY_TAG_INPUT + INPUT_COUNT) continue;
+        uint32_t len = 0;
+        if (tag == REPLAY_TAG_HASH) fseek(r.file, sizeof(uint32_t), SEEK_CUR);
+        else if (tag == REPLAY_TAG_END) break;
+        else if (tag == REPLAY_TAG_KEYFRAME && READ_RAW(r.file, len)) {
+            keyframe_pos = ftell(r.file);
+            fseek(r.file, len, SEEK_CUR);
+            resume_pos = ftell(r.file);
+            resume_tick = tick;
+        } else break;
+    }
+
+    if (keyframe_pos >= 0) {
+        fseek(r.file, keyframe_pos, SEEK_SET);
+        if (!matrix_load_state(mat, r.file)) {
+            fclose(r.file);
+            return UINT64_MAX;
+        }
+        r.done = resume_tick + 1;
+        r.alive = true;
+    } else {
+        // no keyframe early enough, simulate from the very start
+        fclose(r.file);
+        reader_open(&r, path, mat);
+        resume_pos = ftell(r.file);
+    }
+    fseek(r.file, resume_pos, SEEK_SET);
+    r.lastTick = resume_tick;
+
+    // second pass, simulate forward from the keyframe
+    while (r.alive && reader_next(&r, &tag, &tick) && tick <= target) {
+        if (tag < REPLAY_TAG_INPUT + INPUT_COUNT) {
+            reader_advance(&r, tick);
+            if (r.alive && !matrix_apply_input(mat, (enum Input_t)(tag - REPLAY_TAG_INPUT))) r.alive = false;
+            continue;
+        }
+        uint32_t len = 0;
+        if (tag == REPLAY_TAG_HASH) fseek(r.file, sizeof(uint32_t), SEEK_CUR);
+        else if (tag == REPLAY_TAG_KEYFRAME && READ_RAW(r.file, len)) fseek(r.file, len, SEEK_CUR);
+        else break;
+    }
+    reader_advance(&r, target + 1);
+    fclose(r.file);
+    return r.done == 0 ? 0 : r.done - 1;
+}
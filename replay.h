@@ -0,0 +1,103 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+// Compact binary game recordings, and headless re-simulation of them.
+//
+// A recording starts with a header (magic, version, seed, board size) followed by records. Every record
+// starts with a tag byte and a varint tick delta from the previous record. Inputs are stamped with the tick
+// they were applied on, before that tick's `matrix_update`. Hashes and keyframes are taken after it.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "matrix.h"
+
+#define REPLAY_MAGIC "CTRP"
+#define REPLAY_VERSION 7
+#define REPLAY_KEYFRAME_INTERVAL 600 // ticks between full state snapshots, for seeking
+
+// record tags. Inputs are packed into the tag byte itself, `REPLAY_TAG_INPUT + input`
+enum ReplayTag_t {
+    REPLAY_TAG_INPUT = 0x00,
+    REPLAY_TAG_HASH = 0x10, // u32 board hash, after every tick
+    REPLAY_TAG_KEYFRAME = 0x11, // u32 byte length, then a `matrix_save_state` blob
+    REPLAY_TAG_END = 0x12 // u8 reason, u64 points, u64 lines cleared, u32 hash
+};
+
+enum ReplayEnd_t {
+    REPLAY_END_DEATH,
+    REPLAY_END_QUIT
+};
+
+struct ReplayWriter {
+    FILE* file;
+    uint64_t lastTick; // tick of the last record, deltas are relative to it
+    uint64_t nextKeyframe;
+};
+
+struct ReplayResult {
+    uint64_t ticks; // ticks simulated
+    uint64_t inputs;
+    uint64_t hashesChecked;
+    uint64_t keyframesChecked;
+    uint64_t firstMismatchTick; // only meaningful if `ok` is false
+    size_t points;
+    size_t linesCleared;
+    bool ok;
+    char error[128];
+};
+
+/**
+ * Starts recording a game. Call right after the game's first piece has spawned.
+ * @param w Writer state to initialize.
+ * @param path File to create, overwritten if it exists.
+ * @param mat The game to record, only its seed and dimensions are written.
+ * @returns `false` if the file could not be created.
+ */
+bool replay_writer_open(struct ReplayWriter* w, const char* path, Matrix* mat);
+
+/**
+ * Records an input applied on `tick`, before that tick's update.
+ * @param w An open writer.
+ * @param tick Tick number, counting from zero at the start of the game.
+ * @param input The input that was applied.
+ */
+void replay_record_input(struct ReplayWriter* w, uint64_t tick, enum Input_t input);
+
+/**
+ * Records end of tick state, a hash every tick and a keyframe every `REPLAY_KEYFRAME_INTERVAL`. Call after every `matrix_update`.
+ * @param w An open writer.
+ * @param tick Tick number of the update that just ran.
+ * @param mat The recorded game.
+ */
+void replay_record_tick(struct ReplayWriter* w, uint64_t tick, Matrix* mat);
+
+/**
+ * Writes the final score and closes the file.
+ * @param w An open writer, closed afterwards.
+ * @param tick Tick the game ended on.
+ * @param mat The recorded game.
+ * @param reason Why the game ended.
+ */
+void replay_writer_close(struct ReplayWriter* w, uint64_t tick, Matrix* mat, enum ReplayEnd_t reason);
+
+/**
+ * Re-simulates a recording as fast as possible, checking every hash, keyframe and the final score.
+ * Each keyframe is also played forward from, as `replay_seek` would, and has to match the playback tick for tick.
+ * @param path Recording to play back.
+ * @param mat Scratch game to simulate with, reset by the call. Holds the final state afterwards.
+ * @param result Filled in with what was checked, and the first mismatch if there is one.
+ * @returns `true` if the recording played back bit-exact.
+ */
+bool replay_verify(const char* path, Matrix* mat, struct ReplayResult* result);
+
+/**
+ * Reconstructs the game as it was after the update of `tick`, starting from the closest keyframe.
+ * @param path Recording to seek in.
+ * @param tick Tick to stop after. Stops early if the game ended before it.
+ * @param mat Game to restore into.
+ * @returns The tick actually reached, or `UINT64_MAX` if the recording could not be read.
+ */
+uint64_t replay_seek(const char* path, uint64_t tick, Matrix* mat);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef RNG_H
+#define RNG_H
+// Small, fast, seedable PRNG (xoshiro256**). Every game owns one, so games never share state.
+
+#include <stdint.h>
+
+struct Rng {
+    uint64_t s[4];
+};
+
+/**
+ * Seed the generator. Any seed is fine, including zero; it is expanded with splitmix64.
+ * @param rng The generator to seed.
+ * @param seed Seed value, the same seed always gives the same sequence.
+ */
+void rng_seed(struct Rng* rng, uint64_t seed);
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * Next 64 random bits.
+ * @param rng The generator to advance.
+ */
+static inline uint64_t rng_next(struct Rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return result;
+}
+
+/**
+ * Uniform integer in `[0, bound)`, without modulo bias worth caring about for small bounds.
+ * @param rng The generator to advance.
+ * @param bound Exclusive upper limit, must be nonzero.
+ */
+static inline uint32_t rng_below(struct Rng* rng, uint32_t bound) {
+    // multiply-shift on the top 32 bits instead of a division
+    return (uint32_t)(((rng_next(rng) >> 32) * (uint64_t)bound) >> 32);
+}
+
+#endif
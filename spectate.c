@@ -0,0 +1,284 @@
+#include "spectate.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void M_spectate_path(char* out, size_t cap, const char* name) {
+    snprintf(out, cap, "/%s", name);
+}
+
+static struct SpectateShared* M_spectate_map(int fd) {
+    void* at = mmap(NULL, sizeof(struct SpectateShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return at == MAP_FAILED ? NULL : (struct SpectateShared*)at;
+}
+
+// what a cell looks like to viewers, the unlocked piece included
+static inline uint8_t M_spectate_cell(Matrix* mat, size_t i) {
+    return mat->_board[i].occupied ? mat->_board[i].type : (uint8_t)INVALID;
+}
+
+bool spectate_writer_open(struct SpectateWriter* w, const char* name) {
+    memset(w, 0, sizeof(*w));
+    snprintf(w->name, sizeof(w->name), "%s", name);
+    char path[80];
+    M_spectate_path(path, sizeof(path), name);
+
+    // viewers of a previous broadcast, maybe from a game that crashed, keep their mapping of the old object
+    int old_fd = shm_open(path, O_RDWR, 0);
+    if (old_fd >= 0) {
+        struct stat st;
+        struct SpectateShared* old = NULL;
+        if (fstat(old_fd, &st) == 0 && (size_t)st.st_size == sizeof(struct SpectateShared)) old = M_spectate_map(old_fd);
+        else close(old_fd);
+        if (old != NULL) {
+            atomic_store_explicit(&old->closed, true, memory_order_release);
+            munmap(old, sizeof(struct SpectateShared));
+        }
+        shm_unlink(path);
+    }
+
+    int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)sizeof(struct SpectateShared)) != 0) {
+        close(fd);
+        shm_unlink(path);
+        return false;
+    }
+    // a fresh object is all zeroes, every slot sequence says "not written yet"
+    w->shared = M_spectate_map(fd);
+    if (w->shared == NULL) {
+        shm_unlink(path);
+        return false;
+    }
+    memcpy(w->shared->magic, SPECTATE_MAGIC, 4);
+    w->shared->version = SPECTATE_VERSION;
+    return true;
+}
+
+static void M_spectate_fill_state(struct SpectateState* s, Matrix* mat, uint64_t frame, uint64_t tick, enum SpectateStatus_t status) {
+    s->frame = frame;
+    s->tick = tick;
+    s->nrows = mat->_nrows;
+    s->ncols = mat->_ncols;
+    s->rootY = mat->_rootY;
+    s->tetX = mat->_tetX;
+    s->tetY = mat->_tetY;
+    s->hdropX = mat->_hdropX;
+    s->hdropY = mat->_hdropY;
+    s->piece = (uint8_t)mat->_currentPiece;
+    s->rot = mat->_currentRot;
+    s->held = (uint8_t)mat->_heldPiece;
+    s->lastCombo = (uint8_t)mat->_lastCombo;
+    s->status = (uint8_t)status;
+    s->level = mat->_level;
+    s->comboAnimTimer = mat->_comboAnimTimer;
+    s->linesCleared = mat->_linesCleared;
+    s->points = mat->_points;
+    s->lastPoints = mat->_lastPoints;
+    s->b2b = mat->_b2b;
+}
+
+static void M_spectate_write_keyframe(struct SpectateWriter* w, Matrix* mat, const struct SpectateState* state) {
+    struct SpectateKeyframe* key = &w->shared->keyframe;
+    uint64_t seq = atomic_load_explicit(&key->seq, memory_order_relaxed);
+    atomic_store_explicit(&key->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    key->state = *state;
+    memcpy(key->cells, w->shown, (size_t)mat->_nrows * (size_t)mat->_ncols);
+    atomic_store_explicit(&key->seq, seq + 2, memory_order_release);
+}
+
+void spectate_publish(struct SpectateWriter* w, Matrix* mat, uint64_t tick, enum SpectateStatus_t status) {
+    if (w->shared == NULL) return;
+    size_t cell_count = (size_t)mat->_nrows * (size_t)mat->_ncols;
+    if (cell_count > SPECTATE_MAX_CELLS) return;
+
+    uint64_t frame = atomic_load_explicit(&w->shared->published, memory_order_relaxed);
+    struct SpectateSlot* slot = &w->shared->slots[frame % SPECTATE_SLOTS];
+    atomic_store_explicit(&slot->seq, 2 * frame + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    M_spectate_fill_state(&slot->state, mat, frame, tick, status);
+
+    bool resync = false;
+    if (w->nrows != mat->_nrows || w->ncols != mat->_ncols) {
+        if (cell_count > w->shownCap) {
+            free(w->shown);
+            w->shown = (uint8_t*)malloc(cell_count);
+            if (w->shown == NULL) FAIL("Out of memory allocating the spectator board.\n");
+            w->shownCap = cell_count;
+        }
+        for (size_t i = 0; i < cell_count; i++) w->shown[i] = M_spectate_cell(mat, i);
+        w->nrows = mat->_nrows;
+        w->ncols = mat->_ncols;
+        resync = true;
+    } else {
+        uint16_t n = 0;
+        for (size_t i = 0; i < cell_count; i++) {
+            uint8_t type = M_spectate_cell(mat, i);
+            if (type == w->shown[i]) continue;
+            w->shown[i] = type;
+            // past the slot's capacity, keep catching up `shown` for the keyframe
+            if (n < SPECTATE_SLOT_CELLS) {
+                slot->cells[n].y = (uint8_t)(i / (size_t)mat->_ncols);
+                slot->cells[n].x = (uint8_t)(i % (size_t)mat->_ncols);
+                slot->cells[n].type = type;
+            }
+            n++;
+            if (n > SPECTATE_SLOT_CELLS) resync = true;
+        }
+        slot->cellCount = n;
+    }
+
+    // the keyframe goes out before the slot that points to it is complete
+    if (resync || frame >= w->nextKeyframe) {
+        M_spectate_write_keyframe(w, mat, &slot->state);
+        w->nextKeyframe = frame + SPECTATE_KEYFRAME_INTERVAL;
+    }
+    if (resync) slot->cellCount = SPECTATE_RESYNC;
+    atomic_store_explicit(&slot->seq, 2 * frame + 2, memory_order_release);
+    atomic_store_explicit(&w->shared->published, frame + 1, memory_order_release);
+}
+
+void spectate_writer_close(struct SpectateWriter* w) {
+    if (w->shared == NULL) return;
+    atomic_store_explicit(&w->shared->closed, true, memory_order_release);
+    munmap(w->shared, sizeof(struct SpectateShared));
+    w->shared = NULL;
+    char path[80];
+    M_spectate_path(path, sizeof(path), w->name);
+    shm_unlink(path);
+    free(w->shown);
+    w->shown = NULL;
+    w->shownCap = 0;
+}
+
+bool spectate_reader_open(struct SpectateReader* r, const char* name) {
+    memset(r, 0, sizeof(*r));
+    char path[80];
+    M_spectate_path(path, sizeof(path), name);
+    int fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != sizeof(struct SpectateShared)) {
+        close(fd);
+        return false;
+    }
+    r->shared = M_spectate_map(fd);
+    if (r->shared == NULL) return false;
+    if (memcmp(r->shared->magic, SPECTATE_MAGIC, 4) != 0 || r->shared->version != SPECTATE_VERSION) {
+        spectate_reader_close(r);
+        return false;
+    }
+    r->keyCells = (uint8_t*)malloc(SPECTATE_MAX_CELLS);
+    if (r->keyCells == NULL) FAIL("Out of memory allocating the spectator keyframe.\n");
+    return true;
+}
+
+static void M_spectate_apply_state(Matrix* mat, const struct SpectateState* s) {
+    mat->_rootY = s->rootY;
+    mat->_tetX = s->tetX;
+    mat->_tetY = s->tetY;
+    mat->_hdropX = s->hdropX;
+    mat->_hdropY = s->hdropY;
+    mat->_currentPiece = (enum TetrominoType_t)s->piece;
+    mat->_currentPieceData = s->piece != INVALID ? &TData[PIECE_TO_INDEX(s->piece)] : NULL;
+    mat->_currentRot = s->rot;
+    mat->_heldPiece = (enum TetrominoType_t)s->held;
+    mat->_lastCombo = (enum ComboType_t)s->lastCombo;
+    mat->_level = s->level;
+    mat->_comboAnimTimer = s->comboAnimTimer;
+    mat->_linesCleared = s->linesCleared;
+    mat->_points = s->points;
+    mat->_lastPoints = s->lastPoints;
+    mat->_b2b = s->b2b;
+}
+
+// only touches cells that differ, so the draw damage stays small when a synced viewer reads a keyframe
+static inline void M_spectate_set(Matrix* mat, minopos_t y, minopos_t x, uint8_t type) {
+    struct Mino* mino = &MATRIX_AT(mat, y, x);
+    if (mino->occupied == (type != INVALID) && (!mino->occupied || mino->type == type)) return;
+    matrix_set_cell(mat, y, x, (enum TetrominoType_t)type);
+}
+
+static enum SpectateRead_t M_spectate_resync(struct SpectateReader* r, Matrix* mat) {
+    struct SpectateKeyframe* key = &r->shared->keyframe;
+    uint64_t seq = atomic_load_explicit(&key->seq, memory_order_acquire);
+    if (seq == 0 || (seq & 1)) return SPECTATE_READ_NONE; // none yet, or being rewritten. Try again later.
+
+    struct SpectateState state = key->state;
+    size_t cell_count = (size_t)state.nrows * (size_t)state.ncols;
+    if (state.nrows < 4 || state.ncols < 4 || cell_count > SPECTATE_MAX_CELLS) return SPECTATE_READ_NONE;
+    memcpy(r->keyCells, key->cells, cell_count);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&key->seq, memory_order_relaxed) != seq) return SPECTATE_READ_NONE;
+
+    if (mat->_nrows != state.nrows || mat->_ncols != state.ncols) matrix_reset(mat, state.nrows, state.ncols);
+    for (minopos_t y = 0; y < state.nrows; y++) {
+        for (minopos_t x = 0; x < state.ncols; x++)
+            M_spectate_set(mat, y, x, r->keyCells[(size_t)y * (size_t)state.ncols + (size_t)x]);
+    }
+    M_spectate_apply_state(mat, &state);
+    r->state = state;
+    r->next = state.frame + 1;
+    r->synced = true;
+    r->keyframesRead++;
+    return SPECTATE_READ_KEYFRAME;
+}
+
+enum SpectateRead_t spectate_read(struct SpectateReader* r, Matrix* mat) {
+    if (atomic_load_explicit(&r->shared->closed, memory_order_acquire)) return SPECTATE_READ_CLOSED;
+    if (!r->synced) return M_spectate_resync(r, mat);
+
+    struct SpectateSlot* slot = &r->shared->slots[r->next % SPECTATE_SLOTS];
+    uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    uint64_t done = 2 * r->next + 2;
+    if (seq < done) return SPECTATE_READ_NONE;
+    if (seq > done) {
+        // lapped, the frame we wanted is gone
+        r->synced = false;
+        r->resyncs++;
+        return M_spectate_resync(r, mat);
+    }
+
+    // copy out before applying, the writer may be lapping us right now
+    struct SpectateCell* cells = r->slotCells;
+    struct SpectateState state = slot->state;
+    uint16_t count = slot->cellCount;
+    if (count != SPECTATE_RESYNC) {
+        if (count > SPECTATE_SLOT_CELLS) count = SPECTATE_SLOT_CELLS;
+        memcpy(cells, slot->cells, count * sizeof(struct SpectateCell));
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq || count == SPECTATE_RESYNC
+        || state.nrows != mat->_nrows || state.ncols != mat->_ncols) {
+        r->synced = false;
+        if (count != SPECTATE_RESYNC) r->resyncs++;
+        return M_spectate_resync(r, mat);
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (cells[i].y >= mat->_nrows || cells[i].x >= mat->_ncols) continue;
+        M_spectate_set(mat, cells[i].y, cells[i].x, cells[i].type);
+    }
+    M_spectate_apply_state(mat, &state);
+    r->state = state;
+    r->next++;
+    r->framesRead++;
+    return SPECTATE_READ_FRAME;
+}
+
+uint64_t spectate_lag(struct SpectateReader* r) {
+    uint64_t published = atomic_load_explicit(&r->shared->published, memory_order_acquire);
+    return published > r->next ? published - r->next : 0;
+}
+
+void spectate_reader_close(struct SpectateReader* r) {
+    if (r->shared != NULL) munmap(r->shared, sizeof(struct SpectateShared));
+    r->shared = NULL;
+    free(r->keyCells);
+    r->keyCells = NULL;
+}
@@ -0,0 +1,149 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+// Live broadcast of a game to local viewers, through a POSIX shared memory object.
+//
+// The game is the only writer and never waits on viewers. Every published frame goes into a ring of fixed
+// size slots, each with the cells that changed since the previous frame and the piece and score fields.
+// Slots and the keyframe are seqlocks: the sequence is odd while the writer is in them, and a reader keeps
+// a copy only if the sequence was even and unchanged around it. A viewer that was lapped by the writer, or
+// tore a slot, resynchronizes from the keyframe, a full copy of the board rewritten every so often.
+
+#include "matrix.h"
+
+#include <stdatomic.h>
+
+#define SPECTATE_MAGIC "CTRS"
+#define SPECTATE_VERSION 1
+#define SPECTATE_SLOTS 64 // frames a viewer can fall behind before it has to resync
+#define SPECTATE_SLOT_CELLS 256 // changed cells a slot holds, frames that change more send a keyframe instead
+#define SPECTATE_KEYFRAME_INTERVAL 60 // frames between keyframes
+#define SPECTATE_MAX_CELLS (255 * 255) // largest board the menu allows
+#define SPECTATE_RESYNC UINT16_MAX // slot cell count of a frame that is only in the keyframe
+
+enum SpectateStatus_t {
+    SPECTATE_PLAYING,
+    SPECTATE_GAME_OVER
+};
+
+// what a frame carries besides the cells
+struct SpectateState {
+    uint64_t frame; // counts every frame the writer published
+    uint64_t tick; // game tick the frame was taken after
+    minopos_t nrows, ncols, rootY;
+    minopos_t tetX, tetY, hdropX, hdropY;
+    uint8_t piece, rot, held; // enum TetrominoType_t, except `rot`
+    uint8_t lastCombo; // enum ComboType_t
+    uint8_t status; // enum SpectateStatus_t
+    uint32_t level;
+    uint32_t comboAnimTimer;
+    uint64_t linesCleared, points, lastPoints, b2b;
+};
+
+struct SpectateCell {
+    uint8_t y, x;
+    uint8_t type; // enum TetrominoType_t, INVALID for empty
+};
+
+struct SpectateSlot {
+    _Atomic uint64_t seq; // 2 * frame + 1 while the writer fills it, 2 * frame + 2 once it is done
+    struct SpectateState state;
+    uint16_t cellCount; // SPECTATE_RESYNC if the frame only went out as a keyframe
+    struct SpectateCell cells[SPECTATE_SLOT_CELLS];
+};
+
+struct SpectateKeyframe {
+    _Atomic uint64_t seq; // odd while the writer fills it
+    struct SpectateState state;
+    uint8_t cells[SPECTATE_MAX_CELLS]; // type of every cell, row-major, `nrows * ncols` of them are used
+};
+
+// layout of the shared memory object
+struct SpectateShared {
+    char magic[4];
+    uint32_t version;
+    _Atomic uint64_t published; // frames published so far, also the number of the next one
+    _Atomic bool closed; // the writer is gone, or a new one replaced it
+    struct SpectateKeyframe keyframe;
+    struct SpectateSlot slots[SPECTATE_SLOTS];
+};
+
+struct SpectateWriter {
+    struct SpectateShared* shared; // NULL while not broadcasting
+    char name[64];
+    uint8_t* shown; // cells as of the last frame, row-major
+    size_t shownCap;
+    minopos_t nrows, ncols; // size of `shown`, 0 before the first frame
+    uint64_t nextKeyframe;
+};
+
+struct SpectateReader {
+    struct SpectateShared* shared;
+    bool synced; // `next` follows the last frame applied. Cleared to resync from the keyframe.
+    uint64_t next; // frame to read next
+    struct SpectateState state; // of the last frame applied
+    uint8_t* keyCells; // copy of the keyframe cells, so a torn copy never reaches the game
+    struct SpectateCell slotCells[SPECTATE_SLOT_CELLS]; // same for the cells of a slot
+    uint64_t framesRead, keyframesRead, resyncs;
+};
+
+enum SpectateRead_t {
+    SPECTATE_READ_NONE, // nothing new yet
+    SPECTATE_READ_FRAME,
+    SPECTATE_READ_KEYFRAME,
+    SPECTATE_READ_CLOSED // the writer closed, reopen to follow the next one
+};
+
+/**
+ * Start broadcasting under a name. An older broadcast with the same name is marked closed and replaced.
+ * @param w Writer state to initialize.
+ * @param name Shared memory object name, without the leading slash.
+ * @returns `false` if the shared memory could not be created.
+ */
+bool spectate_writer_open(struct SpectateWriter* w, const char* name);
+
+/**
+ * Publish the game as it is now. Never blocks, and costs a pass over the board plus the changed cells.
+ * @param w An open writer, does nothing if it isn't open.
+ * @param mat The broadcast game.
+ * @param tick Game tick the frame follows.
+ * @param status Whether the game is still going.
+ */
+void spectate_publish(struct SpectateWriter* w, Matrix* mat, uint64_t tick, enum SpectateStatus_t status);
+
+/**
+ * Stop broadcasting, viewers see the broadcast close.
+ * @param w An open writer, closed afterwards.
+ */
+void spectate_writer_close(struct SpectateWriter* w);
+
+/**
+ * Attach to a broadcast. The first read resyncs from the keyframe.
+ * @param r Reader state to initialize.
+ * @param name Name the game broadcasts under.
+ * @returns `false` if there is no such broadcast, or it is from an incompatible version.
+ */
+bool spectate_reader_open(struct SpectateReader* r, const char* name);
+
+/**
+ * Apply the next frame to a game, or the keyframe if the reader is out of sync. Never blocks.
+ * @param r An open reader.
+ * @param mat Game rebuilt from the broadcast, resized when the broadcast board is. Only cells, piece, ghost
+ * and score fields are set, it can be drawn but not simulated.
+ * @returns What was applied.
+ */
+enum SpectateRead_t spectate_read(struct SpectateReader* r, Matrix* mat);
+
+/**
+ * How far the reader trails the writer.
+ * @param r An open reader.
+ * @returns Frames published but not read yet.
+ */
+uint64_t spectate_lag(struct SpectateReader* r);
+
+/**
+ * Detach from a broadcast.
+ * @param r An open reader, closed afterwards.
+ */
+void spectate_reader_close(struct SpectateReader* r);
+
+#endif
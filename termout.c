@@ -0,0 +1,65 @@
+#include "termout.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static int tty_fd = -1; // the real terminal, while stdout is the pipe
+static int pipe_read_fd = -1;
+static pthread_t forwarder;
+static _Atomic uint64_t forwarded = 0;
+
+static void* M_termout_forward(void* arg) {
+    (void)arg;
+    char buf[16384];
+    ssize_t n;
+    while ((n = read(pipe_read_fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = write(tty_fd, buf + done, (size_t)(n - done));
+            if (w <= 0) break;
+            done += w;
+        }
+        atomic_fetch_add_explicit(&forwarded, (uint64_t)n, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+bool termout_start() {
+    if (tty_fd >= 0 || !isatty(STDOUT_FILENO) || !isatty(STDERR_FILENO)) return false;
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    tty_fd = dup(STDOUT_FILENO);
+    if (tty_fd < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    pipe_read_fd = fds[0];
+    fflush(stdout);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[1]);
+    if (pthread_create(&forwarder, NULL, M_termout_forward, NULL) != 0) {
+        dup2(tty_fd, STDOUT_FILENO);
+        close(tty_fd);
+        close(pipe_read_fd);
+        tty_fd = pipe_read_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+uint64_t termout_bytes() {
+    return atomic_load_explicit(&forwarded, memory_order_relaxed);
+}
+
+void termout_stop() {
+    if (tty_fd < 0) return;
+    // replacing stdout closes the last write end, the forwarder drains the pipe and sees EOF
+    fflush(stdout);
+    dup2(tty_fd, STDOUT_FILENO);
+    pthread_join(forwarder, NULL);
+    close(tty_fd);
+    close(pipe_read_fd);
+    tty_fd = pipe_read_fd = -1;
+}
@@ -0,0 +1,29 @@
+#ifndef TERMOUT_H
+#define TERMOUT_H
+// Counts the bytes the terminal frontend writes. Curses writes straight to the stdout file descriptor, so a
+// wrapped FILE never sees its output: stdout is pointed at a pipe instead, and a thread forwards everything
+// from it to the real terminal, counting as it goes. Curses then takes terminal modes and the window size
+// from stderr, as it does whenever stdout isn't a terminal.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Start counting. Call before curses is initialized.
+ * @returns `false` if stdout or stderr isn't a terminal, or the pipe or thread could not be made. Output then goes
+ * to the terminal directly and nothing is counted.
+ */
+bool termout_start();
+
+/**
+ * Bytes forwarded to the terminal so far. Output lags by as long as the forwarding thread takes to wake.
+ * @returns Total since `termout_start`.
+ */
+uint64_t termout_bytes();
+
+/**
+ * Point stdout back at the terminal, once everything written so far went out. Call after curses has ended.
+ */
+void termout_stop();
+
+#endif
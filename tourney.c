@@ -0,0 +1,208 @@
+// Headless self-play tournament. Plays many games across every core, each on its own Matrix and seed,
+// driven by an input policy, and reports what they scored. Threads share nothing but the read-only piece data;
+// games are handed out by a work stealing pool so a few long games don't leave the other cores idle.
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "matrix.h"
+#include "policy.h"
+
+struct TourneyConfig {
+    uint32_t games;
+    uint32_t threads;
+    minopos_t rows, cols;
+    uint64_t seed; // game g is seeded with seed + g, so any single game can be replayed on its own
+    uint64_t maxTicks; // a game that lasts this long is stopped, alive
+    const char* script; // inputs for the scripted policy
+};
+
+// summed over the games one thread played, merged once every thread is done
+struct Totals {
+    uint64_t games, survived, ticks, lines;
+    uint64_t combos[COMBO_COUNT];
+};
+
+struct Tourney;
+
+struct Worker {
+    pthread_t thread;
+    pthread_mutex_t lock; // guards `next` and `end`, thieves take from the end
+    uint32_t next, end; // games still queued here, [next, end)
+    uint32_t stolen; // games this worker took from others
+    struct Totals totals;
+    struct Tourney* tourney;
+    uint32_t id;
+};
+
+struct Tourney {
+    struct TourneyConfig config;
+    const struct Policy* policy;
+    struct Worker* workers;
+    uint64_t* points; // per game, each written by the one thread that played it
+};
+
+// takes a queued game, stealing the newer half of another worker's queue once this one is empty
+static bool take_game(struct Worker* w, uint32_t* game) {
+    pthread_mutex_lock(&w->lock);
+    bool found = w->next < w->end;
+    if (found) *game = w->next++;
+    pthread_mutex_unlock(&w->lock);
+    if (found) return true;
+
+    struct Tourney* t = w->tourney;
+    for (uint32_t k = 1; k < t->config.threads; k++) {
+        struct Worker* victim = &t->workers[(w->id + k) % t->config.threads];
+        pthread_mutex_lock(&victim->lock);
+        uint32_t left = victim->end - victim->next;
+        uint32_t begin = victim->next + left / 2, end = victim->end;
+        if (left > 0) victim->end = begin;
+        pthread_mutex_unlock(&victim->lock);
+        if (left == 0) continue;
+
+        pthread_mutex_lock(&w->lock);
+        *game = begin;
+        w->next = begin + 1;
+        w->end = end;
+        w->stolen += end - begin;
+        pthread_mutex_unlock(&w->lock);
+        return true;
+    }
+    return false;
+}
+
+static void* worker_main(void* arg) {
+    struct Worker* w = (struct Worker*)arg;
+    struct Tourney* t = w->tourney;
+    const struct TourneyConfig* config = &t->config;
+    Matrix* mat = matrix_construct_rs(config->rows, config->cols);
+    void* policy_state = t->policy->create(config->script);
+
+    uint32_t game;
+    while (take_game(w, &game)) {
+        uint64_t seed = config->seed + game;
+        bool alive = matrix_new_game(mat, config->rows, config->cols, seed);
+        t->policy->start(policy_state, mat, seed);
+        uint64_t tick = 0;
+        while (alive && tick < config->maxTicks) {
+            alive = matrix_apply_input(mat, t->policy->next(policy_state, mat)) && matrix_update(mat);
+            tick++;
+        }
+
+        w->totals.games++;
+        w->totals.survived += alive;
+        w->totals.ticks += tick;
+        w->totals.lines += mat->_linesCleared;
+        for (int c = 0; c < COMBO_COUNT; c++) w->totals.combos[c] += mat->_comboCounts[c];
+        t->points[game] = mat->_points;
+    }
+
+    t->policy->destroy(policy_state);
+    matrix_destruct(mat);
+    return NULL;
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    struct TourneyConfig config = {64, cores > 0 ? (uint32_t)cores : 1, 24, 10, 1, 10000, "llcsssh"};
+    const char* policy_name = "bot";
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--games") == 0 && has_value) config.games = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--threads") == 0 && has_value) config.threads = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--rows") == 0 && has_value) config.rows = (minopos_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cols") == 0 && has_value) config.cols = (minopos_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && has_value) config.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--ticks") == 0 && has_value) config.maxTicks = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--policy") == 0 && has_value) policy_name = argv[++i];
+        else if (strcmp(argv[i], "--script") == 0 && has_value) config.script = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--games N] [--threads N] [--rows N] [--cols N] [--seed N] [--ticks N]\n"
+                "          [--policy random|scripted|bot] [--script INPUTS]\n"
+                "script inputs: l left, r right, c cw, w ccw, s soft drop, h hard drop, x hold, anything else waits\n", argv[0]);
+            return 2;
+        }
+    }
+
+    const struct Policy* policy = policy_find(policy_name);
+    if (policy == NULL || config.games == 0 || config.threads == 0 || config.rows < 4 || config.cols < 4) {
+        fprintf(stderr, "need a known policy, at least one game and thread, and a board of at least 4x4\n");
+        return 2;
+    }
+    if (config.threads > config.games) config.threads = config.games;
+
+    // the piece data is shared read-only by every thread from here on
+    parse_game_data();
+
+    struct Tourney t = {config, policy, NULL, NULL};
+    t.workers = (struct Worker*)calloc(config.threads, sizeof(struct Worker));
+    t.points = (uint64_t*)calloc(config.games, sizeof(uint64_t));
+    if (t.workers == NULL || t.points == NULL) FAIL("Out of memory allocating the tournament.\n");
+
+    // every worker starts with an even, contiguous share of the games
+    double start = now_seconds();
+    for (uint32_t i = 0; i < config.threads; i++) {
+        struct Worker* w = &t.workers[i];
+        w->tourney = &t;
+        w->id = i;
+        w->next = (uint32_t)((uint64_t)config.games * i / config.threads);
+        w->end = (uint32_t)((uint64_t)config.games * (i + 1) / config.threads);
+        pthread_mutex_init(&w->lock, NULL);
+    }
+    for (uint32_t i = 0; i < config.threads; i++) {
+        if (pthread_create(&t.workers[i].thread, NULL, worker_main, &t.workers[i]) != 0)
+            FAIL("Could not start a worker thread.\n");
+    }
+
+    struct Totals sum = {0};
+    for (uint32_t i = 0; i < config.threads; i++) {
+        struct Worker* w = &t.workers[i];
+        pthread_join(w->thread, NULL);
+        sum.games += w->totals.games;
+        sum.survived += w->totals.survived;
+        sum.ticks += w->totals.ticks;
+        sum.lines += w->totals.lines;
+        for (int c = 0; c < COMBO_COUNT; c++) sum.combos[c] += w->totals.combos[c];
+    }
+    double elapsed = now_seconds() - start;
+    // other workers may try to steal from a finished one, so locks go once all of them are done
+    for (uint32_t i = 0; i < config.threads; i++) pthread_mutex_destroy(&t.workers[i].lock);
+
+    printf("%s policy, %lu games on %u threads in %.3f s: %.2f games/s, %.0f ticks/s\n", policy->name, sum.games,
+        config.threads, elapsed, (double)sum.games / elapsed, (double)sum.ticks / elapsed);
+    printf("%lu reached the %lu tick limit alive\n", sum.survived, config.maxTicks);
+    printf("lines: %lu total, %.1f per game\n", sum.lines, (double)sum.lines / (double)sum.games);
+
+    uint64_t total_points = 0;
+    for (uint32_t g = 0; g < config.games; g++) total_points += t.points[g];
+    qsort(t.points, config.games, sizeof(uint64_t), compare_u64);
+    printf("points: mean %.0f, min %lu, p10 %lu, median %lu, p90 %lu, max %lu\n",
+        (double)total_points / config.games, t.points[0], t.points[config.games / 10], t.points[config.games / 2],
+        t.points[config.games * 9 / 10], t.points[config.games - 1]);
+
+    printf("combos:\n");
+    for (int c = 1; c < COMBO_COUNT; c++) {
+        if (sum.combos[c] > 0)
+            printf("  %-20s %10lu  %8.2f per game\n", combo_to_name((enum ComboType_t)c), sum.combos[c],
+                (double)sum.combos[c] / (double)sum.games);
+    }
+    printf("threads:\n");
+    for (uint32_t i = 0; i < config.threads; i++)
+        printf("  %2u: %lu games, %u stolen\n", i, t.workers[i].totals.games, t.workers[i].stolen);
+
+    free(t.workers);
+    free(t.points);
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "versus.h"
+
+#include <string.h>
+
+void versus_default_attacks(struct AttackTable* table) {
+    memset(table, 0, sizeof(*table));
+    table->lines[DOUBLE] = 1;
+    table->lines[TRIPLE] = 2;
+    table->lines[TETRIS] = 4;
+    table->lines[B2B] = 5;
+    table->lines[T_SPIN_SINGLE] = 2;
+    table->lines[T_SPIN_DOUBLE] = 4;
+    table->lines[T_SPIN_TRIPLE] = 6;
+}
+
+bool versus_parse_attacks(struct AttackTable* table, const char* text) {
+    int combo = SINGLE;
+    while (*text != '\0') {
+        if (combo >= COMBO_COUNT) return false;
+        char* end;
+        unsigned long lines = strtoul(text, &end, 10);
+        if (end == text || lines > UINT8_MAX) return false;
+        table->lines[combo++] = (uint8_t)lines;
+        if (*end == ',') end++;
+        else if (*end != '\0') return false;
+        text = end;
+    }
+    return true;
+}
+
+void versus_begin(struct VersusMatch* match, const struct VersusHello* hello) {
+    memset(match, 0, sizeof(*match));
+    match->attacks = hello->attacks;
+    for (int p = 0; p < 2; p++) {
+        struct VersusPlayer* pl = &match->players[p];
+        pl->game = matrix_construct_rs(hello->rows, hello->cols);
+        pl->alive = matrix_new_game(pl->game, hello->rows, hello->cols, hello->seed);
+        rng_seed(&pl->garbageRng, ~hello->seed - (uint64_t)p); // a different stream than the pieces
+    }
+}
+
+void versus_end(struct VersusMatch* match) {
+    for (int p = 0; p < 2; p++) {
+        matrix_destruct(match->players[p].game);
+        match->players[p].game = NULL;
+    }
+}
+
+static void M_versus_pop_attack(struct VersusPlayer* pl) {
+    pl->pendingLen--;
+    memmove(&pl->pending[0], &pl->pending[1], pl->pendingLen * sizeof(struct VersusAttack));
+}
+
+enum VersusOutcome_t versus_step(struct VersusMatch* match, const enum Input_t inputs[2]) {
+    uint32_t attack[2] = {0, 0};
+    for (int p = 0; p < 2; p++) {
+        struct VersusPlayer* pl = &match->players[p];
+        if (pl->alive) pl->alive = matrix_apply_input(pl->game, inputs[p]) && matrix_update(pl->game);
+
+        // at most one lock per tick, so at most one count changed
+        for (int c = 0; c < COMBO_COUNT; c++) {
+            attack[p] += (pl->game->_comboCounts[c] - pl->combosSeen[c]) * match->attacks.lines[c];
+            pl->combosSeen[c] = pl->game->_comboCounts[c];
+        }
+    }
+
+    // an attack first cancels garbage on its way to the attacker, oldest first
+    for (int p = 0; p < 2; p++) {
+        struct VersusPlayer* pl = &match->players[p];
+        while (attack[p] > 0 && pl->pendingLen > 0) {
+            uint16_t cancel = attack[p] < pl->pending[0].lines ? (uint16_t)attack[p] : pl->pending[0].lines;
+            pl->pending[0].lines = (uint16_t)(pl->pending[0].lines - cancel);
+            attack[p] -= cancel;
+            if (pl->pending[0].lines == 0) M_versus_pop_attack(pl);
+        }
+        pl->lastSent = attack[p] > UINT8_MAX ? UINT8_MAX : (uint16_t)attack[p];
+        pl->linesSent += pl->lastSent;
+    }
+    for (int p = 0; p < 2; p++) {
+        struct VersusPlayer* target = &match->players[1 - p];
+        uint16_t lines = match->players[p].lastSent;
+        if (lines == 0) continue;
+        if (target->pendingLen == VERSUS_PENDING_CAP) {
+            target->pending[VERSUS_PENDING_CAP - 1].lines = (uint16_t)(target->pending[VERSUS_PENDING_CAP - 1].lines + lines);
+        } else {
+            target->pending[target->pendingLen].due = match->tick + VERSUS_GARBAGE_DELAY;
+            target->pending[target->pendingLen].lines = lines;
+            target->pendingLen++;
+        }
+    }
+
+    for (int p = 0; p < 2; p++) {
+        struct VersusPlayer* pl = &match->players[p];
+        while (pl->alive && pl->pendingLen > 0 && pl->pending[0].due <= match->tick) {
+            minopos_t hole = (minopos_t)rng_below(&pl->garbageRng, (uint32_t)pl->game->_ncols);
+            pl->alive = matrix_add_garbage(pl->game, pl->pending[0].lines, hole);
+            pl->linesReceived += pl->pending[0].lines;
+            M_versus_pop_attack(pl);
+        }
+    }
+    match->tick++;
+
+    bool alive0 = match->players[0].alive, alive1 = match->players[1].alive;
+    if (alive0 && alive1) return VERSUS_ONGOING;
+    if (alive0) return VERSUS_WON_0;
+    if (alive1) return VERSUS_WON_1;
+    return VERSUS_DRAW;
+}
+
+uint32_t versus_hash(Matrix* this) {
+    uint64_t h = matrix_hash(this);
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+size_t versus_message_size(uint8_t tag) {
+    switch (tag) {
+        case VERSUS_TAG_HELLO: return VERSUS_HELLO_SIZE;
+        case VERSUS_TAG_INPUT: return 2;
+        case VERSUS_TAG_RESULT: return 6;
+        case VERSUS_TAG_PING: return 9;
+        case VERSUS_TAG_PONG: return 9;
+        case VERSUS_TAG_BYE: return 2;
+        default: return 0;
+    }
+}
+
+static uint8_t* M_versus_put(uint8_t* out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) *out++ = (uint8_t)(v >> (8 * i));
+    return out;
+}
+
+static uint64_t M_versus_get(const uint8_t** in, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= (uint64_t)(*in)[i] << (8 * i);
+    *in += bytes;
+    return v;
+}
+
+size_t versus_write_hello(const struct VersusHello* hello, uint8_t* out) {
+    uint8_t* at = out;
+    *at++ = VERSUS_TAG_HELLO;
+    memcpy(at, VERSUS_MAGIC, 4);
+    at += 4;
+    at = M_versus_put(at, VERSUS_VERSION, 2);
+    at = M_versus_put(at, hello->seed, 8);
+    at = M_versus_put(at, (uint16_t)hello->rows, 2);
+    at = M_versus_put(at, (uint16_t)hello->cols, 2);
+    *at++ = hello->inputDelay;
+    at = M_versus_put(at, hello->maxTicks, 4);
+    memcpy(at, hello->attacks.lines, COMBO_COUNT);
+    at += COMBO_COUNT;
+    return (size_t)(at - out);
+}
+
+bool versus_read_hello(const uint8_t* in, struct VersusHello* hello) {
+    if (in[0] != VERSUS_TAG_HELLO || memcmp(in + 1, VERSUS_MAGIC, 4) != 0) return false;
+    const uint8_t* at = in + 5;
+    if (M_versus_get(&at, 2) != VERSUS_VERSION) return false;
+    hello->seed = M_versus_get(&at, 8);
+    hello->rows = (minopos_t)M_versus_get(&at, 2);
+    hello->cols = (minopos_t)M_versus_get(&at, 2);
+    hello->inputDelay = *at++;
+    hello->maxTicks = (uint32_t)M_versus_get(&at, 4);
+    memcpy(hello->attacks.lines, at, COMBO_COUNT);
+    return hello->rows >= 4 && hello->cols >= 4;
+}
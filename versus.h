@@ -0,0 +1,144 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+// Two player rules and wire format. Both peers simulate both games from the same seed and the exchanged inputs,
+// so a match is lockstep: a tick only runs once both inputs for it are known, and garbage is computed, not sent.
+//
+// Messages are a tag byte followed by a fixed size body, little endian. After the hello, each peer sends one
+// input per tick in tick order, and one result per simulated tick, so neither carries a tick number.
+
+#include "matrix.h"
+
+#define VERSUS_MAGIC "CTRV"
+#define VERSUS_VERSION 5
+#define VERSUS_GARBAGE_DELAY 30 // ticks between a clear and its garbage rising, the receiver can cancel it meanwhile
+#define VERSUS_PENDING_CAP 32 // attacks queued per player, older ones merge once full
+
+enum VersusTag_t {
+    VERSUS_TAG_HELLO = 1, // magic, u16 version, u64 seed, i16 rows, i16 cols, u8 input delay, u32 tick limit, attack table
+    VERSUS_TAG_INPUT, // u8 enum Input_t, for the sender's next tick
+    VERSUS_TAG_RESULT, // u8 garbage lines sent, u32 hash of the sender's game, after the sender's next tick
+    VERSUS_TAG_PING, // u64 sender's clock
+    VERSUS_TAG_PONG, // u64 the ping's clock, echoed
+    VERSUS_TAG_BYE // u8 enum VersusEnd_t
+};
+
+enum VersusEnd_t {
+    VERSUS_END_GAME_OVER,
+    VERSUS_END_QUIT,
+    VERSUS_END_DESYNC
+};
+
+enum VersusOutcome_t {
+    VERSUS_ONGOING,
+    VERSUS_WON_0, // player 0 is the last one standing
+    VERSUS_WON_1,
+    VERSUS_DRAW // both topped out on the same tick
+};
+
+// garbage rows sent per kind of clear. Indexed by enum ComboType_t.
+struct AttackTable {
+    uint8_t lines[COMBO_COUNT];
+};
+
+struct VersusAttack {
+    uint64_t due; // tick it rises on
+    uint16_t lines;
+};
+
+struct VersusPlayer {
+    Matrix* game;
+    struct Rng garbageRng; // hole columns of the garbage this player receives
+    uint32_t combosSeen[COMBO_COUNT]; // `_comboCounts` after the previous tick, clears are told apart by the change
+    struct VersusAttack pending[VERSUS_PENDING_CAP]; // incoming, oldest first
+    uint8_t pendingLen;
+    uint64_t linesSent, linesReceived;
+    uint16_t lastSent; // garbage sent on the latest tick, after cancelling
+    bool alive;
+};
+
+struct VersusMatch {
+    struct VersusPlayer players[2];
+    struct AttackTable attacks;
+    uint64_t tick;
+};
+
+// what a hello carries, the host decides all of it
+struct VersusHello {
+    uint64_t seed;
+    minopos_t rows, cols;
+    uint8_t inputDelay;
+    uint32_t maxTicks; // the match stops there, undecided. 0 for no limit.
+    struct AttackTable attacks;
+};
+
+#define VERSUS_HELLO_SIZE (1 + 4 + 2 + 8 + 2 + 2 + 1 + 4 + COMBO_COUNT)
+#define VERSUS_MAX_MESSAGE VERSUS_HELLO_SIZE
+
+/**
+ * The default attack table: 1, 2 and 4 lines for doubles, triples and tetrises, 5 for a back-to-back tetris,
+ * 2, 4 and 6 for T-spin singles, doubles and triples. Singles, minis and other spins send nothing.
+ * @param table Filled in.
+ */
+void versus_default_attacks(struct AttackTable* table);
+
+/**
+ * Read an attack table written as comma separated line counts, in enum ComboType_t order, starting at SINGLE.
+ * Missing trailing entries keep their current value.
+ * @param table Updated.
+ * @param text e.g. "0,1,2,4".
+ * @returns `false` if the text is malformed, `table` may be partly updated.
+ */
+bool versus_parse_attacks(struct AttackTable* table, const char* text);
+
+/**
+ * Start a match, both games from the same seed so they see the same pieces.
+ * @param match Filled in. Owns two new Matrix instances, free with `versus_end`.
+ * @param hello Seed, board size and attack table.
+ */
+void versus_begin(struct VersusMatch* match, const struct VersusHello* hello);
+
+/**
+ * Free the games of a match.
+ * @param match The match.
+ */
+void versus_end(struct VersusMatch* match);
+
+/**
+ * Run one tick of both games: inputs and updates, then attacks, then garbage that is due.
+ * @param match The match.
+ * @param inputs Input of each player for this tick.
+ * @returns Whether the match is over, and who won.
+ */
+enum VersusOutcome_t versus_step(struct VersusMatch* match, const enum Input_t inputs[2]);
+
+/**
+ * Short hash of a game, as carried in results.
+ * @param this The game.
+ * @returns 32 bits of `matrix_hash`.
+ */
+uint32_t versus_hash(Matrix*);
+
+/**
+ * Size of a message, from its tag.
+ * @param tag The first byte of the message.
+ * @returns Bytes including the tag, 0 for an unknown tag.
+ */
+size_t versus_message_size(uint8_t tag);
+
+/**
+ * Encode a hello.
+ * @param hello What to send.
+ * @param out At least VERSUS_HELLO_SIZE bytes.
+ * @returns Bytes written.
+ */
+size_t versus_write_hello(const struct VersusHello* hello, uint8_t* out);
+
+/**
+ * Decode a hello.
+ * @param in A whole message, VERSUS_HELLO_SIZE bytes.
+ * @param hello Filled in.
+ * @returns `false` if the magic or version don't match, or the board is too small.
+ */
+bool versus_read_hello(const uint8_t* in, struct VersusHello* hello);
+
+#endif
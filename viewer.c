@@ -0,0 +1,147 @@
+// Watches a game broadcast with `game --spectate NAME`. Rebuilds the board from the shared memory ring and
+// draws it with the game's own drawing code. Only ever reads the broadcast, so it can't slow the game down.
+#include <curses.h>
+#include <ctype.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "matrix.h"
+#include "draw.h"
+#include "spectate.h"
+
+#define REOPEN_FRAMES 30 // frames between attempts to find the broadcast while there is none
+#define MAX_READS_PER_FRAME (4 * SPECTATE_SLOTS) // a viewer further behind than this resyncs anyway
+
+static bool running_flag = true;
+
+static void stop_viewer() {
+    running_flag = false;
+}
+
+static void close_viewer() {
+    endwin();
+    draw_free();
+}
+
+static void init_viewer() {
+    matrix_fail_hook = close_viewer;
+    if (!draw_setup_locale()) {
+        fprintf(stderr, "--half-blocks needs a UTF-8 locale under curses, or --renderer ansi.\n");
+        exit(1);
+    }
+    initscr();
+    start_color();
+    if (draw_backend == DRAW_CURSES && !can_change_color()) {
+        close_viewer();
+        fprintf(stderr, "Error in terminal: Does not support custom colors. Try --renderer ansi.\n");
+        exit(1);
+    }
+    clear();
+    refresh(); // curses clears the screen on its first refresh, get it done before anything else is drawn
+    curs_set(0);
+    noecho();
+    signal(SIGINT, stop_viewer);
+    cbreak();
+    nodelay(stdscr, true);
+}
+
+int main(int argc, char** argv) {
+    const char* name = "cursetris";
+    int fps = 60;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--name") == 0 && has_value) name = argv[++i];
+        else if (strcmp(argv[i], "--fps") == 0 && has_value) fps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--renderer") == 0 && has_value && draw_backend_parse(argv[i + 1], &draw_backend)) i++;
+        else if (strcmp(argv[i], "--half-blocks") == 0) draw_half_blocks = true;
+        else {
+            fprintf(stderr, "usage: %s [--name NAME] [--fps N] [--renderer curses|ansi] [--half-blocks]\n"
+                "watches `game --spectate NAME`. Lower --fps redraws less often, frames in between are still read.\n", argv[0]);
+            return 2;
+        }
+    }
+    if (fps < 1 || fps > 1000) {
+        fprintf(stderr, "fps must be 1 to 1000\n");
+        return 2;
+    }
+
+    init_viewer();
+    init_palette();
+    parse_game_data();
+    Matrix* mat = matrix_construct();
+
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_fd < 0) FAIL("Could not create the frame timer.\n");
+    struct itimerspec spec = {0};
+    spec.it_interval.tv_sec = spec.it_value.tv_sec = fps == 1 ? 1 : 0;
+    spec.it_interval.tv_nsec = spec.it_value.tv_nsec = fps == 1 ? 0 : 1000000000L / fps;
+    timerfd_settime(timer_fd, 0, &spec, NULL);
+
+    struct SpectateReader reader = {0};
+    bool attached = false;
+    bool shown = false; // a keyframe was applied since attaching, `mat` is worth drawing
+    uint64_t frame_count = 0;
+    uint64_t reopen_at = 0;
+    while (running_flag) {
+        int c;
+        while ((c = getch()) != ERR) {
+            if (tolower(c) == 'q') running_flag = false;
+        }
+
+        if (!attached && frame_count >= reopen_at) {
+            attached = spectate_reader_open(&reader, name);
+            shown = false;
+            reopen_at = frame_count + REOPEN_FRAMES;
+        }
+        for (int i = 0; attached && i < MAX_READS_PER_FRAME; i++) {
+            enum SpectateRead_t got = spectate_read(&reader, mat);
+            if (got == SPECTATE_READ_NONE) break;
+            if (got == SPECTATE_READ_CLOSED) {
+                spectate_reader_close(&reader);
+                attached = false;
+                break;
+            }
+            if (got == SPECTATE_READ_KEYFRAME && !shown) {
+                draw_erase();
+                draw_invalidate();
+                shown = true;
+            }
+        }
+
+        int scry, scrx;
+        getmaxyx(stdscr, scry, scrx);
+        if (attached && shown) {
+            matrix_draw(mat);
+            char status[128];
+            snprintf(status, sizeof(status), "%s  tick %lu  behind %lu  resyncs %lu  %s",
+                name, reader.state.tick, spectate_lag(&reader), reader.resyncs,
+                reader.state.status == SPECTATE_GAME_OVER ? "GAME OVER" : "");
+            GCOLOR(DEFAULT, draw_printw(scry - 1, 0, "%-*.*s", scrx - 1, scrx - 1, status));
+        } else {
+            if (shown) draw_erase();
+            shown = false;
+            char waiting[128];
+            snprintf(waiting, sizeof(waiting), "waiting for `game --spectate %s`, Q quits", name);
+            GCOLOR(DEFAULT, draw_text_centered(scrx / 2, scry / 2, waiting));
+        }
+        draw_present();
+
+        uint64_t expirations;
+        struct pollfd fds[2] = {
+            {.fd = STDIN_FILENO, .events = POLLIN},
+            {.fd = timer_fd, .events = POLLIN}
+        };
+        if (poll(fds, 2, -1) < 0) continue;
+        if ((fds[1].revents & POLLIN) && read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+            frame_count += expirations;
+    }
+
+    if (attached) spectate_reader_close(&reader);
+    matrix_destruct(mat);
+    close(timer_fd);
+    close_viewer();
+    return 0;
+}